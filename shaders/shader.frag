@@ -1,13 +1,31 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(binding = 1) uniform sampler2D tex_sampler;
+// Specialization constants, see ShaderFeatures.
+layout(constant_id = 0) const bool use_texture = true;
+layout(constant_id = 1) const bool use_vertex_color = false;
+layout(constant_id = 2) const bool alpha_test = false;
+layout(constant_id = 3) const float alpha_cutoff = 0.5;
+
+// Bindless texture table, indexed per object.
+layout(binding = 2) uniform sampler2D textures[];
 
 layout(location = 0) in vec3 frag_color;
 layout(location = 1) in vec2 frag_tex_coords;
+layout(location = 2) flat in uint frag_texture;
 
 layout(location = 0) out vec4 out_color;
 
 void main() {
-	out_color = texture(tex_sampler, frag_tex_coords);
+	vec4 color = vec4(1.0);
+	if (use_texture) {
+		color = texture(textures[nonuniformEXT(frag_texture)], frag_tex_coords);
+	}
+	if (use_vertex_color) {
+		color.rgb *= frag_color;
+	}
+	if (alpha_test && color.a < alpha_cutoff) {
+		discard;
+	}
+	out_color = color;
 }
-
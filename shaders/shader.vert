@@ -1,24 +1,57 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Specialization constants, see ShaderFeatures.
+layout(constant_id = 4) const bool use_model_matrix = true;
+layout(constant_id = 5) const bool quantized_positions = false;
+layout(constant_id = 6) const float position_scale = 1.0;
 
 layout(binding = 0) uniform UniformBufferObject
 {
-	mat4 model;
-	mat4 view;
-	mat4 projection;
+	mat4 view_proj;
+	vec4 frustum[6];
 }
 ubo;
 
+layout(push_constant) uniform DrawConstants
+{
+	mat4 model;
+	uint objects;
+}
+draw;
+
+struct ObjectData {
+	vec3 offset;
+	uint texture_index;
+	vec4 bounds;
+};
+
+// Bindless buffer table; draw.objects selects the object buffer.
+layout(std430, binding = 1) readonly buffer ObjectBuffer
+{
+	ObjectData objects[];
+}
+buffers[];
+
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 vert_color;
 layout(location = 2) in vec2 vert_tex_coords;
 
 layout(location = 0) out vec3 frag_color;
 layout(location = 1) out vec2 frag_tex_coords;
+layout(location = 2) flat out uint frag_texture;
 
 void main()
 {
-	gl_Position =
-			ubo.projection * ubo.view * ubo.model * vec4(position, 1.0);
+	ObjectData object = buffers[draw.objects].objects[gl_InstanceIndex];
+	vec3 offset = object.offset;
+	vec3 local = quantized_positions ? position * position_scale : position;
+	vec4 model_position = vec4(local + offset, 1.0);
+	if (use_model_matrix) {
+		model_position = draw.model * model_position;
+	}
+	gl_Position = ubo.view_proj * model_position;
 	frag_color = vert_color;
 	frag_tex_coords = vert_tex_coords;
+	frag_texture = object.texture_index;
 }
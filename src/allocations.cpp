@@ -0,0 +1,234 @@
+#include "allocations.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <new>
+
+// glibc's own allocator, which the replacements below forward to.
+// NOLINTBEGIN(bugprone-reserved-identifier)
+extern "C" {
+auto __libc_malloc(size_t size) -> void*;
+auto __libc_calloc(size_t count, size_t size) -> void*;
+auto __libc_realloc(void* pointer, size_t size) -> void*;
+auto __libc_memalign(size_t alignment, size_t size) -> void*;
+auto __libc_free(void* pointer) -> void;
+}
+// NOLINTEND(bugprone-reserved-identifier)
+
+namespace {
+
+class PhaseCounters
+{
+ public:
+	std::atomic<uint64_t> count{0};
+	std::atomic<uint64_t> bytes{0};
+};
+
+std::array<PhaseCounters, allocation_phase_count> phase_counters{};
+std::atomic<AllocationPhase> current_phase{AllocationPhase::idle};
+thread_local AllocationStats thread_stats{};
+
+auto record(size_t size) -> void
+{
+	auto phase = current_phase.load(std::memory_order_relaxed);
+	auto& counters = phase_counters[static_cast<size_t>(phase)];
+	counters.count.fetch_add(1, std::memory_order_relaxed);
+	counters.bytes.fetch_add(size, std::memory_order_relaxed);
+	thread_stats.count += 1;
+	thread_stats.bytes += size;
+}
+
+auto allocate_or_fail(size_t size, size_t alignment) -> void*
+{
+	size = std::max(size, size_t{1});
+	auto* pointer = alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__
+			? std::malloc(size)
+			: std::aligned_alloc(
+						alignment,
+						(size + alignment - 1) / alignment * alignment);
+	if (pointer == nullptr) {
+		std::fputs("FATAL: Out of memory.\n", stderr);
+		std::terminate();
+	}
+	return pointer;
+}
+
+}  // namespace
+
+auto heap_allocation_count() -> uint64_t
+{
+	auto count = uint64_t{};
+	for (auto const& counters : phase_counters) {
+		count += counters.count.load(std::memory_order_relaxed);
+	}
+	return count;
+}
+
+auto phase_allocations(AllocationPhase phase) -> AllocationStats
+{
+	auto const& counters = phase_counters[static_cast<size_t>(phase)];
+	return AllocationStats{
+			.count = counters.count.load(std::memory_order_relaxed),
+			.bytes = counters.bytes.load(std::memory_order_relaxed),
+	};
+}
+
+auto thread_allocations() -> AllocationStats
+{
+	return thread_stats;
+}
+
+auto set_allocation_phase(AllocationPhase phase) -> void
+{
+	current_phase.store(phase, std::memory_order_relaxed);
+}
+
+auto allocation_phase_name(AllocationPhase phase) -> char const*
+{
+	switch (phase) {
+		case AllocationPhase::idle:
+			return "idle";
+		case AllocationPhase::wait:
+			return "wait";
+		case AllocationPhase::update:
+			return "update";
+		case AllocationPhase::acquire:
+			return "acquire";
+		case AllocationPhase::record:
+			return "record";
+		case AllocationPhase::submit:
+			return "submit";
+	}
+	return "unknown";
+}
+
+extern "C" {
+
+auto malloc(size_t size) noexcept -> void*
+{
+	record(size);
+	return __libc_malloc(size);
+}
+
+auto calloc(size_t count, size_t size) noexcept -> void*
+{
+	record(count * size);
+	return __libc_calloc(count, size);
+}
+
+auto realloc(void* pointer, size_t size) noexcept -> void*
+{
+	record(size);
+	return __libc_realloc(pointer, size);
+}
+
+auto memalign(size_t alignment, size_t size) noexcept -> void*
+{
+	record(size);
+	return __libc_memalign(alignment, size);
+}
+
+auto aligned_alloc(size_t alignment, size_t size) noexcept -> void*
+{
+	record(size);
+	return __libc_memalign(alignment, size);
+}
+
+auto posix_memalign(void** pointer, size_t alignment, size_t size) noexcept
+		-> int
+{
+	record(size);
+	*pointer = __libc_memalign(alignment, size);
+	return *pointer == nullptr ? ENOMEM : 0;
+}
+
+auto free(void* pointer) noexcept -> void
+{
+	__libc_free(pointer);
+}
+
+}  // extern "C"
+
+auto operator new(size_t size) -> void*
+{
+	return allocate_or_fail(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+auto operator new[](size_t size) -> void*
+{
+	return allocate_or_fail(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+auto operator new(size_t size, std::align_val_t alignment) -> void*
+{
+	return allocate_or_fail(size, static_cast<size_t>(alignment));
+}
+
+auto operator new[](size_t size, std::align_val_t alignment) -> void*
+{
+	return allocate_or_fail(size, static_cast<size_t>(alignment));
+}
+
+auto operator new(size_t size, std::nothrow_t const& /*tag*/) noexcept -> void*
+{
+	return std::malloc(std::max(size, size_t{1}));
+}
+
+auto operator new[](size_t size, std::nothrow_t const& /*tag*/) noexcept
+		-> void*
+{
+	return std::malloc(std::max(size, size_t{1}));
+}
+auto operator delete(void* pointer) noexcept -> void
+{
+	std::free(pointer);
+}
+
+auto operator delete[](void* pointer) noexcept -> void
+{
+	std::free(pointer);
+}
+
+auto operator delete(void* pointer, size_t /*size*/) noexcept -> void
+{
+	std::free(pointer);
+}
+
+auto operator delete[](void* pointer, size_t /*size*/) noexcept -> void
+{
+	std::free(pointer);
+}
+
+auto operator delete(void* pointer, std::align_val_t /*alignment*/) noexcept
+		-> void
+{
+	std::free(pointer);
+}
+
+auto operator delete[](void* pointer, std::align_val_t /*alignment*/) noexcept
+		-> void
+{
+	std::free(pointer);
+}
+
+auto operator delete(
+		void* pointer,
+		size_t /*size*/,
+		std::align_val_t /*alignment*/) noexcept -> void
+{
+	std::free(pointer);
+}
+
+auto operator delete[](
+		void* pointer,
+		size_t /*size*/,
+		std::align_val_t /*alignment*/) noexcept -> void
+{
+	std::free(pointer);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// What the frame loop is doing, for attributing heap allocations. The phase is
+// process-wide, so allocations by job threads helping a frame land in it too.
+enum class AllocationPhase : uint8_t {
+	idle,
+	wait,
+	update,
+	acquire,
+	record,
+	submit,
+};
+
+auto const allocation_phase_count = size_t{6};
+
+class AllocationStats
+{
+ public:
+	uint64_t count = 0;
+	uint64_t bytes = 0;
+};
+
+// Every allocation through malloc, its relatives and operator new is counted,
+// by any thread, since the program started. Counting is cheap enough to stay
+// enabled.
+auto heap_allocation_count() -> uint64_t;
+auto phase_allocations(AllocationPhase phase) -> AllocationStats;
+// Allocations made by the calling thread.
+auto thread_allocations() -> AllocationStats;
+
+auto set_allocation_phase(AllocationPhase phase) -> void;
+auto allocation_phase_name(AllocationPhase phase) -> char const*;
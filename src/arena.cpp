@@ -0,0 +1,71 @@
+#include "arena.hpp"
+
+#include <fmt/core.h>
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+
+using fmt::print;
+
+namespace {
+
+auto const huge_page_size = size_t{2} << 20;
+
+}  // namespace
+
+Arena::Arena(size_t capacity, bool huge_pages)
+{
+	auto* memory = MAP_FAILED;
+	if (huge_pages) {
+		capacity = (capacity + huge_page_size - 1) / huge_page_size * huge_page_size;
+		memory = mmap(
+				nullptr,
+				capacity,
+				PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+				-1,
+				0);
+	}
+	if (memory == MAP_FAILED) {
+		memory = mmap(
+				nullptr,
+				capacity,
+				PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS,
+				-1,
+				0);
+		if (memory == MAP_FAILED) {
+			print(stderr, "FATAL: Failed to map a {} byte arena.\n", capacity);
+			std::terminate();
+		}
+		if (huge_pages) {
+			madvise(memory, capacity, MADV_HUGEPAGE);
+		}
+	}
+	_memory = static_cast<std::byte*>(memory);
+	_capacity = capacity;
+}
+
+Arena::~Arena()
+{
+	munmap(_memory, _capacity);
+}
+
+auto Arena::allocate(size_t size, size_t alignment) -> void*
+{
+	auto address = reinterpret_cast<uintptr_t>(_memory + _used);
+	auto padding = (alignment - address % alignment) % alignment;
+	if (_used + padding + size > _capacity) {
+		print(
+				stderr,
+				"FATAL: Arena of {} bytes exhausted by a {} byte allocation.\n",
+				_capacity,
+				size);
+		std::terminate();
+	}
+	auto* pointer = _memory + _used + padding;
+	_used += padding + size;
+	return pointer;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Bump allocator over a single up-front mapping. Allocating is a pointer
+// increment, freeing is a no-op, and reset() releases everything at once.
+// Not thread-safe: each arena belongs to one thread at a time.
+class Arena
+{
+ public:
+	// With `huge_pages`, the mapping is backed by 2 MiB pages if the system
+	// has any reserved, and otherwise marked for transparent huge pages.
+	explicit Arena(size_t capacity, bool huge_pages = false);
+	~Arena();
+
+	Arena(Arena const&) = delete;
+	Arena(Arena&&) = delete;
+	auto operator=(Arena const&) -> Arena& = delete;
+	auto operator=(Arena&&) -> Arena& = delete;
+
+	auto allocate(size_t size, size_t alignment) -> void*;
+
+	auto reset() -> void
+	{
+		_used = 0;
+	}
+
+	[[nodiscard]] auto used() const -> size_t
+	{
+		return _used;
+	}
+
+	[[nodiscard]] auto capacity() const -> size_t
+	{
+		return _capacity;
+	}
+
+ private:
+	std::byte* _memory = nullptr;
+	size_t _capacity = 0;
+	size_t _used = 0;
+};
+
+// Standard allocator drawing from an Arena, for containers that only live
+// until the arena is reset.
+template <typename T>
+class ArenaAllocator
+{
+ public:
+	using value_type = T;
+
+	explicit ArenaAllocator(Arena& arena) : _arena{&arena} {}
+
+	template <typename U>
+	// NOLINTNEXTLINE(google-explicit-constructor)
+	ArenaAllocator(ArenaAllocator<U> const& other) : _arena{other.arena()}
+	{
+	}
+
+	auto allocate(size_t count) -> T*
+	{
+		return static_cast<T*>(_arena->allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	auto deallocate(T* /*pointer*/, size_t /*count*/) -> void {}
+
+	[[nodiscard]] auto arena() const -> Arena*
+	{
+		return _arena;
+	}
+
+	template <typename U>
+	auto operator==(ArenaAllocator<U> const& other) const -> bool
+	{
+		return _arena == other.arena();
+	}
+
+ private:
+	Arena* _arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
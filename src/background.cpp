@@ -0,0 +1,63 @@
+#include "background.hpp"
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+
+namespace {
+
+// Nice value of the background threads. On Linux it applies to the calling
+// thread only.
+auto const background_priority = 10;
+
+}  // namespace
+
+BackgroundThreads::BackgroundThreads(unsigned thread_count)
+{
+	thread_count = std::max(thread_count, 1u);
+	_threads.reserve(thread_count);
+	for (auto i = 0u; i < thread_count; ++i) {
+		_threads.emplace_back([this] { thread_main(); });
+	}
+}
+
+BackgroundThreads::~BackgroundThreads()
+{
+	{
+		auto lock = std::scoped_lock{_mutex};
+		_running = false;
+	}
+	_condition.notify_all();
+	for (auto& thread : _threads) {
+		thread.join();
+	}
+}
+
+auto BackgroundThreads::resume(std::coroutine_handle<> handle) -> void
+{
+	{
+		auto lock = std::scoped_lock{_mutex};
+		_queue.push_back(handle);
+	}
+	_condition.notify_one();
+}
+
+auto BackgroundThreads::thread_main() -> void
+{
+#ifdef __linux__
+	setpriority(PRIO_PROCESS, 0, background_priority);
+#endif
+	while (true) {
+		auto lock = std::unique_lock{_mutex};
+		_condition.wait(lock, [this] { return !_queue.empty() || !_running; });
+		if (_queue.empty()) {
+			return;
+		}
+		auto handle = _queue.front();
+		_queue.pop_front();
+		lock.unlock();
+		handle.resume();
+	}
+}
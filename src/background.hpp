@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads for long-running work such as pipeline compilation, kept apart from
+// the job system so that a frame waiting for its jobs never picks up a task
+// that takes milliseconds. They run at a lower priority than the frame
+// threads and resume queued coroutines in order.
+class BackgroundThreads
+{
+ public:
+	explicit BackgroundThreads(unsigned thread_count);
+	// Finishes everything queued before returning.
+	~BackgroundThreads();
+
+	BackgroundThreads(BackgroundThreads const&) = delete;
+	BackgroundThreads(BackgroundThreads&&) = delete;
+	auto operator=(BackgroundThreads const&) -> BackgroundThreads& = delete;
+	auto operator=(BackgroundThreads&&) -> BackgroundThreads& = delete;
+
+	auto resume(std::coroutine_handle<> handle) -> void;
+
+ private:
+	auto thread_main() -> void;
+
+	std::vector<std::thread> _threads;
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::deque<std::coroutine_handle<>> _queue;
+	bool _running = true;
+};
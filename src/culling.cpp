@@ -0,0 +1,500 @@
+#include "culling.hpp"
+
+#include <fmt/core.h>
+#include <immintrin.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <glm/ext.hpp>
+#include <random>
+#include <thread>
+
+using fmt::print;
+using std::array;
+using std::span;
+using std::vector;
+
+namespace {
+
+// Half-extent of the padding entries. It is finite, since -Ofast lets the
+// compiler assume that no float is infinite or NaN, and small enough that
+// plane distances against normalized planes cannot overflow.
+auto const padding_extent = 1e30f;
+
+// Smallest number of objects worth handing to another thread.
+auto const min_parallel_chunk = size_t{16384};
+
+// Upper bound on the chunks of one cull_parallel call, so the per-chunk
+// counts fit on the stack.
+auto const max_parallel_chunks = size_t{64};
+
+auto sphere_visible(Frustum const& frustum, glm::vec3 center, float radius)
+		-> bool
+{
+	for (auto const& plane : frustum) {
+		if (glm::dot(glm::vec3{plane}, center) + plane.w + radius <= 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+auto box_visible(Frustum const& frustum, glm::vec3 lower, glm::vec3 upper)
+		-> bool
+{
+	for (auto const& plane : frustum) {
+		auto normal = glm::vec3{plane};
+		auto corner = glm::vec3{
+				normal.x > 0.0f ? upper.x : lower.x,
+				normal.y > 0.0f ? upper.y : lower.y,
+				normal.z > 0.0f ? upper.z : lower.z,
+		};
+		if (!(glm::dot(normal, corner) + plane.w >= 0.0f)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+#if defined(__AVX512F__)
+
+auto cull_spheres_simd(
+		Frustum const& frustum,
+		CullingBounds const& bounds,
+		size_t begin,
+		size_t end,
+		uint32_t* visible) -> size_t
+{
+	auto count = size_t{};
+	auto lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	for (auto i = begin; i < end; i += 16) {
+		auto x = _mm512_loadu_ps(&bounds.center_x[i]);
+		auto y = _mm512_loadu_ps(&bounds.center_y[i]);
+		auto z = _mm512_loadu_ps(&bounds.center_z[i]);
+		auto r = _mm512_loadu_ps(&bounds.radius[i]);
+		auto mask = __mmask16{0xFFFF};
+		for (auto const& plane : frustum) {
+			auto distance = _mm512_add_ps(r, _mm512_set1_ps(plane.w));
+			distance = _mm512_fmadd_ps(_mm512_set1_ps(plane.x), x, distance);
+			distance = _mm512_fmadd_ps(_mm512_set1_ps(plane.y), y, distance);
+			distance = _mm512_fmadd_ps(_mm512_set1_ps(plane.z), z, distance);
+			mask = _mm512_mask_cmp_ps_mask(
+					mask,
+					distance,
+					_mm512_setzero_ps(),
+					_CMP_GT_OQ);
+		}
+		auto indices =
+				_mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(i)), lanes);
+		_mm512_mask_compressstoreu_epi32(visible + count, mask, indices);
+		count += std::popcount(static_cast<unsigned>(mask));
+	}
+	return count;
+}
+
+auto cull_boxes_simd(
+		Frustum const& frustum,
+		CullingBounds const& bounds,
+		size_t begin,
+		size_t end,
+		uint32_t* visible) -> size_t
+{
+	auto count = size_t{};
+	auto lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	for (auto i = begin; i < end; i += 16) {
+		auto mask = __mmask16{0xFFFF};
+		for (auto const& plane : frustum) {
+			// The plane's sign pattern picks the box corner furthest along the
+			// normal, so every lane tests the same arrays.
+			auto const& x = plane.x > 0.0f ? bounds.max_x : bounds.min_x;
+			auto const& y = plane.y > 0.0f ? bounds.max_y : bounds.min_y;
+			auto const& z = plane.z > 0.0f ? bounds.max_z : bounds.min_z;
+			auto distance = _mm512_set1_ps(plane.w);
+			distance = _mm512_fmadd_ps(
+					_mm512_set1_ps(plane.x),
+					_mm512_loadu_ps(&x[i]),
+					distance);
+			distance = _mm512_fmadd_ps(
+					_mm512_set1_ps(plane.y),
+					_mm512_loadu_ps(&y[i]),
+					distance);
+			distance = _mm512_fmadd_ps(
+					_mm512_set1_ps(plane.z),
+					_mm512_loadu_ps(&z[i]),
+					distance);
+			mask = _mm512_mask_cmp_ps_mask(
+					mask,
+					distance,
+					_mm512_setzero_ps(),
+					_CMP_GE_OQ);
+		}
+		auto indices =
+				_mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(i)), lanes);
+		_mm512_mask_compressstoreu_epi32(visible + count, mask, indices);
+		count += std::popcount(static_cast<unsigned>(mask));
+	}
+	return count;
+}
+
+#elif defined(__AVX2__)
+
+auto madd(__m256 a, __m256 b, __m256 c) -> __m256
+{
+#if defined(__FMA__)
+	return _mm256_fmadd_ps(a, b, c);
+#else
+	return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+auto append_lanes(uint32_t* visible, size_t count, size_t base, int mask)
+		-> size_t
+{
+	auto bits = static_cast<unsigned>(mask);
+	while (bits != 0) {
+		visible[count++] = static_cast<uint32_t>(base + std::countr_zero(bits));
+		bits &= bits - 1;
+	}
+	return count;
+}
+
+auto cull_spheres_simd(
+		Frustum const& frustum,
+		CullingBounds const& bounds,
+		size_t begin,
+		size_t end,
+		uint32_t* visible) -> size_t
+{
+	auto count = size_t{};
+	for (auto i = begin; i < end; i += 8) {
+		auto x = _mm256_loadu_ps(&bounds.center_x[i]);
+		auto y = _mm256_loadu_ps(&bounds.center_y[i]);
+		auto z = _mm256_loadu_ps(&bounds.center_z[i]);
+		auto r = _mm256_loadu_ps(&bounds.radius[i]);
+		auto mask = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (auto const& plane : frustum) {
+			auto distance = _mm256_add_ps(r, _mm256_set1_ps(plane.w));
+			distance = madd(_mm256_set1_ps(plane.x), x, distance);
+			distance = madd(_mm256_set1_ps(plane.y), y, distance);
+			distance = madd(_mm256_set1_ps(plane.z), z, distance);
+			mask = _mm256_and_ps(
+					mask,
+					_mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GT_OQ));
+		}
+		count = append_lanes(visible, count, i, _mm256_movemask_ps(mask));
+	}
+	return count;
+}
+
+auto cull_boxes_simd(
+		Frustum const& frustum,
+		CullingBounds const& bounds,
+		size_t begin,
+		size_t end,
+		uint32_t* visible) -> size_t
+{
+	auto count = size_t{};
+	for (auto i = begin; i < end; i += 8) {
+		auto mask = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (auto const& plane : frustum) {
+			// The plane's sign pattern picks the box corner furthest along the
+			// normal, so every lane tests the same arrays.
+			auto const& x = plane.x > 0.0f ? bounds.max_x : bounds.min_x;
+			auto const& y = plane.y > 0.0f ? bounds.max_y : bounds.min_y;
+			auto const& z = plane.z > 0.0f ? bounds.max_z : bounds.min_z;
+			auto distance = _mm256_set1_ps(plane.w);
+			distance =
+					madd(_mm256_set1_ps(plane.x), _mm256_loadu_ps(&x[i]), distance);
+			distance =
+					madd(_mm256_set1_ps(plane.y), _mm256_loadu_ps(&y[i]), distance);
+			distance =
+					madd(_mm256_set1_ps(plane.z), _mm256_loadu_ps(&z[i]), distance);
+			mask = _mm256_and_ps(
+					mask,
+					_mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		count = append_lanes(visible, count, i, _mm256_movemask_ps(mask));
+	}
+	return count;
+}
+
+#endif
+
+auto random_bounds(size_t count) -> CullingBounds
+{
+	auto engine = std::mt19937{count};
+	auto position = std::uniform_real_distribution<float>{-100.0f, 100.0f};
+	auto extent = std::uniform_real_distribution<float>{0.25f, 2.0f};
+	auto bounds = CullingBounds{};
+	bounds.reserve(count);
+	for (auto i = size_t{}; i < count; ++i) {
+		auto center = glm::vec3{position(engine), position(engine), position(engine)};
+		auto half = glm::vec3{extent(engine), extent(engine), extent(engine)};
+		bounds.push_back(
+				glm::vec4{center, glm::length(half)},
+				center - half,
+				center + half);
+	}
+	return bounds;
+}
+
+template <typename Function>
+auto time_per_object(size_t count, Function const& function) -> double
+{
+	auto iterations = std::max(size_t{1}, size_t{20'000'000} / count);
+	auto start = std::chrono::steady_clock::now();
+	for (auto i = size_t{}; i < iterations; ++i) {
+		function();
+	}
+	auto elapsed = std::chrono::duration<double, std::nano>(
+			std::chrono::steady_clock::now() - start);
+	return elapsed.count() / static_cast<double>(iterations * count);
+}
+
+}  // namespace
+
+auto frustum_planes(glm::mat4 const& matrix) -> Frustum
+{
+	auto row = [&](int i) {
+		return glm::vec4{matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]};
+	};
+	auto planes = Frustum{
+			row(3) + row(0),
+			row(3) - row(0),
+			row(3) + row(1),
+			row(3) - row(1),
+			row(2),
+			row(3) - row(2),
+	};
+	for (auto& plane : planes) {
+		plane /= glm::length(glm::vec3{plane});
+	}
+	return planes;
+}
+
+auto CullingBounds::reserve(size_t count) -> void
+{
+	auto padded = (count + lane_count - 1) / lane_count * lane_count;
+	for (auto* array : {
+					 &center_x,
+					 &center_y,
+					 &center_z,
+					 &radius,
+					 &min_x,
+					 &min_y,
+					 &min_z,
+					 &max_x,
+					 &max_y,
+					 &max_z,
+			 }) {
+		array->reserve(padded);
+	}
+}
+
+auto CullingBounds::clear() -> void
+{
+	for (auto* array : {
+					 &center_x,
+					 &center_y,
+					 &center_z,
+					 &radius,
+					 &min_x,
+					 &min_y,
+					 &min_z,
+					 &max_x,
+					 &max_y,
+					 &max_z,
+			 }) {
+		array->clear();
+	}
+	_size = 0;
+}
+
+auto CullingBounds::push_back(
+		glm::vec4 const& sphere,
+		glm::vec3 lower,
+		glm::vec3 upper) -> void
+{
+	if (_size == padded_size()) {
+		// A hugely negative radius and a hugely inverted box are at least
+		// padding_extent behind every plane with a normalized normal.
+		auto padded = _size + lane_count;
+		center_x.resize(padded, 0.0f);
+		center_y.resize(padded, 0.0f);
+		center_z.resize(padded, 0.0f);
+		radius.resize(padded, -padding_extent);
+		min_x.resize(padded, padding_extent);
+		min_y.resize(padded, padding_extent);
+		min_z.resize(padded, padding_extent);
+		max_x.resize(padded, -padding_extent);
+		max_y.resize(padded, -padding_extent);
+		max_z.resize(padded, -padding_extent);
+	}
+	center_x[_size] = sphere.x;
+	center_y[_size] = sphere.y;
+	center_z[_size] = sphere.z;
+	radius[_size] = sphere.w;
+	min_x[_size] = lower.x;
+	min_y[_size] = lower.y;
+	min_z[_size] = lower.z;
+	max_x[_size] = upper.x;
+	max_y[_size] = upper.y;
+	max_z[_size] = upper.z;
+	_size += 1;
+}
+
+auto cull_instruction_set() -> char const*
+{
+#if defined(__AVX512F__)
+	return "AVX-512";
+#elif defined(__AVX2__)
+	return "AVX2";
+#else
+	return "scalar";
+#endif
+}
+
+auto cull_scalar(
+		Frustum const& frustum,
+		CullingBounds const& bounds,
+		BoundingVolume volume,
+		size_t begin,
+		size_t end,
+		uint32_t* visible) -> size_t
+{
+	auto count = size_t{};
+	for (auto i = begin; i < end; ++i) {
+		auto inside = volume == BoundingVolume::sphere
+				? sphere_visible(
+							frustum,
+							glm::vec3{
+									bounds.center_x[i],
+									bounds.center_y[i],
+									bounds.center_z[i]},
+							bounds.radius[i])
+				: box_visible(
+							frustum,
+							glm::vec3{bounds.min_x[i], bounds.min_y[i], bounds.min_z[i]},
+							glm::vec3{bounds.max_x[i], bounds.max_y[i], bounds.max_z[i]});
+		if (inside) {
+			visible[count++] = static_cast<uint32_t>(i);
+		}
+	}
+	return count;
+}
+
+auto cull_simd(
+		Frustum const& frustum,
+		CullingBounds const& bounds,
+		BoundingVolume volume,
+		size_t begin,
+		size_t end,
+		uint32_t* visible) -> size_t
+{
+#if defined(__AVX512F__) || defined(__AVX2__)
+	if (volume == BoundingVolume::sphere) {
+		return cull_spheres_simd(frustum, bounds, begin, end, visible);
+	}
+	return cull_boxes_simd(frustum, bounds, begin, end, visible);
+#else
+	return cull_scalar(frustum, bounds, volume, begin, end, visible);
+#endif
+}
+
+auto cull_parallel(
+		Frustum const& frustum,
+		CullingBounds const& bounds,
+		BoundingVolume volume,
+		span<uint32_t> visible,
+		JobSystem& jobs) -> size_t
+{
+	auto padded = bounds.padded_size();
+	auto chunk_count = std::clamp(
+			padded / min_parallel_chunk,
+			size_t{1},
+			std::min(size_t{jobs.thread_count()}, max_parallel_chunks));
+	auto lanes = CullingBounds::lane_count;
+	auto chunk_size =
+			((padded + chunk_count - 1) / chunk_count + lanes - 1) / lanes * lanes;
+	auto counts = array<size_t, max_parallel_chunks>{};
+	auto cull_chunk = [&](size_t chunk) {
+		auto begin = std::min(chunk * chunk_size, padded);
+		auto end = std::min(begin + chunk_size, padded);
+		counts[chunk] =
+				cull_simd(frustum, bounds, volume, begin, end, &visible[begin]);
+	};
+	auto counter = JobCounter{};
+	for (auto chunk = size_t{1}; chunk < chunk_count; ++chunk) {
+		jobs.run(counter, [&cull_chunk, chunk] { cull_chunk(chunk); });
+	}
+	cull_chunk(0);
+	jobs.wait(counter);
+	auto total = counts[0];
+	for (auto chunk = size_t{1}; chunk < chunk_count; ++chunk) {
+		auto begin = visible.begin() + static_cast<ptrdiff_t>(chunk * chunk_size);
+		std::copy(
+				begin,
+				begin + static_cast<ptrdiff_t>(counts[chunk]),
+				visible.begin() + static_cast<ptrdiff_t>(total));
+		total += counts[chunk];
+	}
+	return total;
+}
+
+auto benchmark_culling() -> void
+{
+	auto threads = std::max(std::thread::hardware_concurrency(), 1u);
+	auto jobs = JobSystem{threads};
+	auto view_proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 80.0f) *
+			glm::lookAt(
+					glm::vec3{0.0f, 0.0f, 0.0f},
+					glm::vec3{1.0f, 0.5f, 0.25f},
+					glm::vec3{0.0f, 0.0f, 1.0f});
+	auto frustum = frustum_planes(view_proj);
+	print(
+			"{:>9} {:>6} {:>9} {:>14} {:>14} {:>14}\n",
+			"objects",
+			"volume",
+			"visible",
+			"scalar ns/obj",
+			fmt::format("{} ns/obj", cull_instruction_set()),
+			fmt::format("{}T ns/obj", threads));
+	for (auto count : array<size_t, 4>{10'000, 100'000, 300'000, 1'000'000}) {
+		auto bounds = random_bounds(count);
+		auto visible = vector<uint32_t>(bounds.padded_size());
+		for (auto volume : {BoundingVolume::sphere, BoundingVolume::box}) {
+			auto visible_count = size_t{};
+			auto scalar = time_per_object(count, [&] {
+				visible_count = cull_scalar(
+						frustum,
+						bounds,
+						volume,
+						0,
+						bounds.padded_size(),
+						visible.data());
+			});
+			auto simd = time_per_object(count, [&] {
+				visible_count = cull_simd(
+						frustum,
+						bounds,
+						volume,
+						0,
+						bounds.padded_size(),
+						visible.data());
+			});
+			auto parallel = time_per_object(count, [&] {
+				visible_count = cull_parallel(frustum, bounds, volume, visible, jobs);
+			});
+			print(
+					"{:>9} {:>6} {:>9} {:>14.3f} {:>14.3f} {:>14.3f}\n",
+					count,
+					volume == BoundingVolume::sphere ? "sphere" : "box",
+					visible_count,
+					scalar,
+					simd,
+					parallel);
+		}
+	}
+}
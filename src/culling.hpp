@@ -0,0 +1,94 @@
+#pragma once
+
+#include "jobs.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+// Inward-facing, normalized planes in the order left, right, bottom, top,
+// near, far. A point p is inside when dot(plane.xyz, p) + plane.w >= 0.
+using Frustum = std::array<glm::vec4, 6>;
+
+enum class BoundingVolume {
+	sphere,
+	box,
+};
+
+// Extracts the clip planes of a view-projection matrix (Gribb & Hartmann).
+auto frustum_planes(glm::mat4 const& matrix) -> Frustum;
+
+// Bounding spheres and axis-aligned boxes in structure-of-arrays form. Every
+// array is padded to a multiple of `lane_count` with entries that never pass
+// a frustum test, so the SIMD kernels can always process full lanes.
+class CullingBounds
+{
+ public:
+	static constexpr auto lane_count = size_t{16};
+
+	auto reserve(size_t count) -> void;
+	auto clear() -> void;
+	auto push_back(glm::vec4 const& sphere, glm::vec3 lower, glm::vec3 upper)
+			-> void;
+
+	[[nodiscard]] auto size() const -> size_t
+	{
+		return _size;
+	}
+
+	[[nodiscard]] auto padded_size() const -> size_t
+	{
+		return center_x.size();
+	}
+
+	std::vector<float> center_x;
+	std::vector<float> center_y;
+	std::vector<float> center_z;
+	std::vector<float> radius;
+	std::vector<float> min_x;
+	std::vector<float> min_y;
+	std::vector<float> min_z;
+	std::vector<float> max_x;
+	std::vector<float> max_y;
+	std::vector<float> max_z;
+
+ private:
+	size_t _size = 0;
+};
+
+// Name of the instruction set the vectorized kernels were compiled for.
+auto cull_instruction_set() -> char const*;
+
+// Writes the indices of the objects in [begin, end) that intersect the frustum
+// to `visible` and returns how many were written. `begin` must be a multiple
+// of CullingBounds::lane_count and `end` may not exceed the padded size.
+auto cull_scalar(
+		Frustum const& frustum,
+		CullingBounds const& bounds,
+		BoundingVolume volume,
+		size_t begin,
+		size_t end,
+		uint32_t* visible) -> size_t;
+
+auto cull_simd(
+		Frustum const& frustum,
+		CullingBounds const& bounds,
+		BoundingVolume volume,
+		size_t begin,
+		size_t end,
+		uint32_t* visible) -> size_t;
+
+// Culls every object, splitting the work into lane-aligned chunks processed
+// as jobs. `visible` must hold at least bounds.padded_size() entries; the
+// visible indices are compacted to its front in ascending order.
+auto cull_parallel(
+		Frustum const& frustum,
+		CullingBounds const& bounds,
+		BoundingVolume volume,
+		std::span<uint32_t> visible,
+		JobSystem& jobs) -> size_t;
+
+auto benchmark_culling() -> void;
@@ -0,0 +1,68 @@
+#include "frame_limiter.hpp"
+
+#include <time.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <thread>
+
+namespace {
+
+auto const nanoseconds_per_second = int64_t{1'000'000'000};
+
+// Bounds of the time spent spinning before a deadline, and the slack added to
+// the worst oversleep seen. The margin decays by 1/64 per frame, so a single
+// slow wake-up does not make the limiter spin for long.
+auto const min_spin_margin = int64_t{50'000};
+auto const max_spin_margin = int64_t{2'000'000};
+auto const spin_slack = int64_t{20'000};
+
+auto monotonic_now() -> int64_t
+{
+	auto now = timespec{};
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * nanoseconds_per_second + now.tv_nsec;
+}
+
+}  // namespace
+
+FrameLimiter::FrameLimiter(uint32_t target_fps) : _spin_margin{min_spin_margin}
+{
+	if (target_fps > 0) {
+		_period = nanoseconds_per_second / target_fps;
+	}
+}
+
+auto FrameLimiter::wait() -> void
+{
+	if (_period == 0) {
+		return;
+	}
+	auto now = monotonic_now();
+	_deadline += _period;
+	// After a frame that overran its slot, or on the first one, the schedule
+	// starts afresh rather than rushing to catch up.
+	if (now >= _deadline) {
+		_deadline = now;
+		return;
+	}
+	auto wake = _deadline - _spin_margin;
+	if (wake > now) {
+		auto until = timespec{
+				.tv_sec = wake / nanoseconds_per_second,
+				.tv_nsec = wake % nanoseconds_per_second,
+		};
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr) ==
+					 EINTR) {
+		}
+		auto oversleep = monotonic_now() - wake;
+		_spin_margin = std::clamp(
+				std::max(_spin_margin - _spin_margin / 64, oversleep + spin_slack),
+				min_spin_margin,
+				max_spin_margin);
+	}
+	while ((now = monotonic_now()) < _deadline) {
+		std::this_thread::yield();
+	}
+	_worst_lateness = std::max(_worst_lateness, now - _deadline);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+// Starts frames a fixed period apart. It sleeps on CLOCK_MONOTONIC until
+// shortly before each deadline and spins through the rest, widening the spin
+// margin whenever the scheduler wakes it late, so frames start within tens of
+// microseconds of their deadlines without spinning for most of the period.
+class FrameLimiter
+{
+ public:
+	// A `target_fps` of zero disables the limiter.
+	explicit FrameLimiter(uint32_t target_fps);
+
+	auto wait() -> void;
+
+	// Latest a wait has returned after its deadline since the last reset, in
+	// nanoseconds.
+	[[nodiscard]] auto worst_lateness() const -> int64_t
+	{
+		return _worst_lateness;
+	}
+
+	auto reset_worst_lateness() -> void
+	{
+		_worst_lateness = 0;
+	}
+
+ private:
+	int64_t _period = 0;
+	int64_t _deadline = 0;
+	int64_t _spin_margin;
+	int64_t _worst_lateness = 0;
+};
@@ -0,0 +1,295 @@
+#include "jobs.hpp"
+
+#include <fmt/core.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+
+using fmt::print;
+using std::array;
+
+namespace {
+
+thread_local JobSystem const* current_system = nullptr;
+thread_local void* current_worker_slot = nullptr;
+
+// Failed steal or pop attempts before an idle worker goes to sleep.
+auto const spin_count = 256;
+
+// Sleepers also wake up on their own after this long, which bounds the cost
+// of a wake-up lost to the unsynchronized check in JobSystem::wake.
+auto const sleep_timeout = std::chrono::milliseconds{1};
+
+auto pin_to_core([[maybe_unused]] unsigned core) -> void
+{
+#ifdef __linux__
+	auto cpus = cpu_set_t{};
+	CPU_ZERO(&cpus);
+	CPU_SET(core, &cpus);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+}
+
+auto next_random(uint32_t& state) -> uint32_t
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+}  // namespace
+
+auto JobDeque::push(Job* job) -> bool
+{
+	auto bottom = _bottom.load(std::memory_order_relaxed);
+	auto top = _top.load(std::memory_order_acquire);
+	if (bottom - top >= capacity) {
+		return false;
+	}
+	_jobs[bottom % capacity].store(job, std::memory_order_relaxed);
+	_bottom.store(bottom + 1, std::memory_order_release);
+	return true;
+}
+
+auto JobDeque::pop() -> Job*
+{
+	auto bottom = _bottom.load(std::memory_order_relaxed) - 1;
+	_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto top = _top.load(std::memory_order_relaxed);
+	if (top > bottom) {
+		_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	auto* job = _jobs[bottom % capacity].load(std::memory_order_relaxed);
+	if (top == bottom) {
+		// Last job: race the thieves for it.
+		if (!_top.compare_exchange_strong(
+						top,
+						top + 1,
+						std::memory_order_seq_cst,
+						std::memory_order_relaxed)) {
+			job = nullptr;
+		}
+		_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+auto JobDeque::steal() -> Job*
+{
+	auto top = _top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto bottom = _bottom.load(std::memory_order_acquire);
+	if (top >= bottom) {
+		return nullptr;
+	}
+	auto* job = _jobs[top % capacity].load(std::memory_order_relaxed);
+	if (!_top.compare_exchange_strong(
+					top,
+					top + 1,
+					std::memory_order_seq_cst,
+					std::memory_order_relaxed)) {
+		return nullptr;
+	}
+	return job;
+}
+
+auto JobSystem::Worker::free_job() -> Job*
+{
+	for (auto i = size_t{}; i < jobs.size(); ++i) {
+		auto* job = &jobs[next_job++ % jobs.size()];
+		if (!job->busy()) {
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+JobSystem::JobSystem(unsigned thread_count)
+{
+	thread_count = std::max(thread_count, 1u);
+	_workers.reserve(thread_count);
+	for (auto i = 0u; i < thread_count; ++i) {
+		_workers.push_back(std::make_unique<Worker>());
+		_workers.back()->random = 0x9e3779b9u * (i + 1);
+	}
+	_workers[0]->owner.store(
+			std::this_thread::get_id(), std::memory_order_relaxed);
+	current_system = this;
+	current_worker_slot = _workers[0].get();
+	_threads.reserve(thread_count - 1);
+	for (auto i = 1u; i < thread_count; ++i) {
+		_threads.emplace_back([this, i] { worker_main(i); });
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	_running.store(false, std::memory_order_relaxed);
+	{
+		auto lock = std::scoped_lock{_sleep_mutex};
+		_sleep_condition.notify_all();
+	}
+	for (auto& thread : _threads) {
+		thread.join();
+	}
+	if (current_system == this) {
+		current_system = nullptr;
+		current_worker_slot = nullptr;
+	}
+}
+
+auto JobSystem::wait(JobCounter const& counter) -> void
+{
+	auto& worker = current_worker();
+	while (!counter.done()) {
+		if (!try_run_job(worker)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+auto JobSystem::help() -> bool
+{
+	return try_run_job(current_worker());
+}
+
+auto JobSystem::adopt_current_thread() -> void
+{
+	// The previous owner's thread-locals still point at the worker, so the
+	// owner recorded in the worker is what decides who may use it.
+	_workers[0]->owner.store(
+			std::this_thread::get_id(), std::memory_order_release);
+	current_system = this;
+	current_worker_slot = _workers[0].get();
+}
+
+auto JobSystem::current_worker() -> Worker&
+{
+	if (current_system != this) {
+		print(stderr, "Jobs may only be used from the job system's threads.\n");
+		std::terminate();
+	}
+	auto& worker = *static_cast<Worker*>(current_worker_slot);
+	if (worker.owner.load(std::memory_order_acquire) !=
+			std::this_thread::get_id()) {
+		print(stderr, "Jobs used from a thread whose worker was handed over.\n");
+		std::terminate();
+	}
+	return worker;
+}
+
+auto JobSystem::try_run_job(Worker& worker) -> bool
+{
+	auto* job = worker.deque.pop();
+	if (job == nullptr && _workers.size() > 1) {
+		auto count = static_cast<uint32_t>(_workers.size());
+		auto first = next_random(worker.random) % count;
+		for (auto i = 0u; i < count && job == nullptr; ++i) {
+			auto& victim = *_workers[(first + i) % count];
+			if (&victim != &worker) {
+				job = victim.deque.steal();
+			}
+		}
+	}
+	if (job == nullptr) {
+		return false;
+	}
+	(*job)();
+	return true;
+}
+
+auto JobSystem::worker_main(unsigned index) -> void
+{
+	pin_to_core(index % std::max(std::thread::hardware_concurrency(), 1u));
+	_workers[index]->owner.store(
+			std::this_thread::get_id(), std::memory_order_relaxed);
+	current_system = this;
+	current_worker_slot = _workers[index].get();
+	auto& worker = *_workers[index];
+	auto idle = 0;
+	while (_running.load(std::memory_order_relaxed)) {
+		if (try_run_job(worker)) {
+			idle = 0;
+			continue;
+		}
+		if (++idle < spin_count) {
+			std::this_thread::yield();
+			continue;
+		}
+		auto lock = std::unique_lock{_sleep_mutex};
+		_sleeping.fetch_add(1, std::memory_order_seq_cst);
+		_sleep_condition.wait_for(lock, sleep_timeout);
+		_sleeping.fetch_sub(1, std::memory_order_relaxed);
+		idle = 0;
+	}
+}
+
+auto JobSystem::wake() -> void
+{
+	if (_sleeping.load(std::memory_order_seq_cst) > 0) {
+		_sleep_condition.notify_one();
+	}
+}
+
+auto benchmark_jobs() -> void
+{
+	auto const job_count = 1000;
+	auto const rounds = 100;
+	auto const element_count = size_t{1} << 22;
+	auto elements = std::vector<float>(element_count);
+	auto single_thread = 0.0;
+	print(
+			"{:>7} {:>12} {:>16} {:>8}\n",
+			"threads",
+			"ns/job",
+			"parallel_for ms",
+			"speedup");
+	for (auto threads : array<unsigned, 7>{1, 2, 4, 8, 16, 32, 64}) {
+		auto jobs = JobSystem{threads};
+
+		// Scheduling overhead: empty jobs submitted from one thread.
+		auto start = std::chrono::steady_clock::now();
+		for (auto round = 0; round < rounds; ++round) {
+			auto counter = JobCounter{};
+			for (auto i = 0; i < job_count; ++i) {
+				jobs.run(counter, [] {});
+			}
+			jobs.wait(counter);
+		}
+		auto overhead = std::chrono::duration<double, std::nano>(
+				std::chrono::steady_clock::now() - start);
+
+		// Scaling: a compute-bound loop split with parallel_for.
+		start = std::chrono::steady_clock::now();
+		for (auto round = 0; round < 10; ++round) {
+			jobs.parallel_for(element_count, 4096, [&](size_t begin, size_t end) {
+				for (auto i = begin; i < end; ++i) {
+					auto x = static_cast<float>(i);
+					elements[i] = std::sqrt(x) * std::sin(x) + std::cos(x);
+				}
+			});
+		}
+		auto loop = std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - start);
+		auto milliseconds = loop.count() / 10;
+		if (threads == 1) {
+			single_thread = milliseconds;
+		}
+		print(
+				"{:>7} {:>12.1f} {:>16.3f} {:>8.2f}\n",
+				threads,
+				overhead.count() / (rounds * job_count),
+				milliseconds,
+				single_thread / milliseconds);
+	}
+}
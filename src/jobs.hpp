@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Number of jobs that still have to finish before whoever waits on the
+// counter may proceed.
+class JobCounter
+{
+ public:
+	[[nodiscard]] auto done() const -> bool
+	{
+		return _pending.load(std::memory_order_acquire) == 0;
+	}
+
+ private:
+	friend class Job;
+	friend class JobSystem;
+	std::atomic<uint32_t> _pending{0};
+};
+
+// A callable stored inline, so that submitting a job never allocates. A
+// job is busy from assign() until it has finished running, and its slot
+// may only be reused after that.
+class Job
+{
+ public:
+	static constexpr auto storage_size = size_t{48};
+
+	[[nodiscard]] auto busy() const -> bool
+	{
+		return _busy.load(std::memory_order_acquire);
+	}
+
+	template <typename Function>
+	auto assign(Function&& function, JobCounter* counter) -> void
+	{
+		using Stored = std::decay_t<Function>;
+		static_assert(sizeof(Stored) <= storage_size, "Job captures too much.");
+		static_assert(alignof(Stored) <= alignof(std::max_align_t));
+		new (_storage.data()) Stored(std::forward<Function>(function));
+		_invoke = [](void* storage) {
+			auto* stored = std::launder(static_cast<Stored*>(storage));
+			(*stored)();
+			stored->~Stored();
+		};
+		_counter = counter;
+		_busy.store(true, std::memory_order_relaxed);
+	}
+
+	auto operator()() -> void
+	{
+		_invoke(_storage.data());
+		_counter->_pending.fetch_sub(1, std::memory_order_release);
+		_busy.store(false, std::memory_order_release);
+	}
+
+ private:
+	void (*_invoke)(void*) = nullptr;
+	JobCounter* _counter = nullptr;
+	std::atomic<bool> _busy{false};
+	alignas(std::max_align_t) std::array<std::byte, storage_size> _storage{};
+};
+
+// Fixed-capacity Chase-Lev deque (Lê et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models"). Only the owning thread pushes and
+// pops at the bottom; any thread may steal from the top.
+class JobDeque
+{
+ public:
+	static constexpr auto capacity = int64_t{4096};
+
+	auto push(Job* job) -> bool;
+	auto pop() -> Job*;
+	auto steal() -> Job*;
+
+	[[nodiscard]] auto empty() const -> bool
+	{
+		return _top.load(std::memory_order_relaxed) >=
+				_bottom.load(std::memory_order_relaxed);
+	}
+
+ private:
+	alignas(64) std::atomic<int64_t> _top{0};
+	alignas(64) std::atomic<int64_t> _bottom{0};
+	alignas(64) std::array<std::atomic<Job*>, capacity> _jobs{};
+};
+
+// Fixed pool of worker threads, pinned to cores, that run jobs from per-thread
+// deques and steal from each other when they run dry. The thread constructing
+// the system becomes worker zero: it has a deque of its own and runs jobs
+// while it waits, but is never pinned. Jobs may only be submitted from
+// threads belonging to the system.
+class JobSystem
+{
+ public:
+	// `thread_count` includes the constructing thread.
+	explicit JobSystem(unsigned thread_count);
+	~JobSystem();
+
+	JobSystem(JobSystem const&) = delete;
+	JobSystem(JobSystem&&) = delete;
+	auto operator=(JobSystem const&) -> JobSystem& = delete;
+	auto operator=(JobSystem&&) -> JobSystem& = delete;
+
+	[[nodiscard]] auto thread_count() const -> unsigned
+	{
+		return static_cast<unsigned>(_workers.size());
+	}
+
+	// Queues `function` on the calling thread's deque and adds it to `counter`.
+	// Each thread can have at most JobDeque::capacity jobs queued or running;
+	// past that the job runs immediately.
+	template <typename Function>
+	auto run(JobCounter& counter, Function&& function) -> void
+	{
+		auto& worker = current_worker();
+		counter._pending.fetch_add(1, std::memory_order_relaxed);
+		auto* job = worker.free_job();
+		if (job == nullptr) {
+			auto overflow = Job{};
+			overflow.assign(std::forward<Function>(function), &counter);
+			overflow();
+			return;
+		}
+		job->assign(std::forward<Function>(function), &counter);
+		if (!worker.deque.push(job)) {
+			(*job)();
+			return;
+		}
+		wake();
+	}
+
+	// Queues a job that nobody waits for.
+	template <typename Function>
+	auto run(Function&& function) -> void
+	{
+		run(_detached, std::forward<Function>(function));
+	}
+
+	// Runs queued or stolen jobs until every job in `counter` has finished.
+	auto wait(JobCounter const& counter) -> void;
+
+	// Runs one queued or stolen job on the calling thread, if there is any.
+	auto help() -> bool;
+
+	// Hands worker zero over to the calling thread. The thread that held it
+	// loses it: using the system from there afterwards terminates.
+	auto adopt_current_thread() -> void;
+
+	// Calls function(begin, end) over [0, count) in chunks of at least `grain`
+	// elements and returns once all of them have finished.
+	template <typename Function>
+	auto parallel_for(size_t count, size_t grain, Function const& function)
+			-> void
+	{
+		if (count == 0) {
+			return;
+		}
+		auto chunks = size_t{thread_count()} * 4;
+		auto chunk = std::max({grain, (count + chunks - 1) / chunks, size_t{1}});
+		auto counter = JobCounter{};
+		for (auto begin = chunk; begin < count; begin += chunk) {
+			auto end = std::min(begin + chunk, count);
+			run(counter, [&function, begin, end] { function(begin, end); });
+		}
+		function(size_t{0}, std::min(chunk, count));
+		wait(counter);
+	}
+
+ private:
+	class Worker
+	{
+	 public:
+		JobDeque deque;
+		std::array<Job, JobDeque::capacity> jobs{};
+		size_t next_job = 0;
+		uint32_t random = 0;
+		// The only thread that may push to or pop from the deque.
+		std::atomic<std::thread::id> owner;
+
+		// Returns a slot whose job has finished, or null if every job is still
+		// queued or running. Every queued job holds a slot, so the deque has
+		// room whenever a slot is free.
+		auto free_job() -> Job*;
+	};
+
+	auto current_worker() -> Worker&;
+	auto try_run_job(Worker& worker) -> bool;
+	auto worker_main(unsigned index) -> void;
+	auto wake() -> void;
+
+	std::vector<std::unique_ptr<Worker>> _workers;
+	std::vector<std::thread> _threads;
+	JobCounter _detached;
+	std::atomic<bool> _running{true};
+	std::atomic<uint32_t> _sleeping{0};
+	std::mutex _sleep_mutex;
+	std::condition_variable _sleep_condition;
+};
+
+auto benchmark_jobs() -> void;
@@ -10,6 +10,15 @@
 #define VULKAN_HPP_NO_CONSTRUCTORS
 #define VULKAN_HPP_NO_EXCEPTIONS
 
+#include "allocations.hpp"
+#include "arena.hpp"
+#include "culling.hpp"
+#include "frame_limiter.hpp"
+#include "jobs.hpp"
+#include "shader_watcher.hpp"
+#include "spsc.hpp"
+#include "task.hpp"
+
 #include <fmt/core.h>
 #include <GLFW/glfw3.h>
 #include <stb_image.h>
@@ -17,22 +26,35 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <exception>
 #include <filesystem>
 #include <fstream>
 #include <glm/ext.hpp>
 #include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <optional>
 #include <span>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <vulkan/vulkan.hpp>
 
 using fmt::print;
 using std::array;
+using std::ceil;
 using std::clamp;
 using std::ifstream;
 using std::ios;
@@ -51,6 +73,67 @@ auto const validation_layers =
 		array<char const*, 1>{"VK_LAYER_KHRONOS_validation"};
 auto const device_extensions =
 		array<char const*, 1>{VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+// Upper bounds on the bindless tables, further limited by the device.
+auto const bindless_texture_limit = uint32_t{16384};
+auto const bindless_buffer_limit = uint32_t{1024};
+auto const cull_group_size = uint32_t{64};
+// Copies of the culling resources with async compute, so that culling for one
+// frame can run while the previous one draws.
+auto const async_cull_frames = size_t{2};
+// Timestamp queries: a pair per copy for culling on the compute queue, then
+// the pair for the graphics work of a frame.
+auto const graphics_timestamps = uint32_t{2 * async_cull_frames};
+auto const hiz_group_size = uint32_t{8};
+// Longest the main thread waits for input before simulating another tick
+// while a render thread draws, in seconds.
+auto const simulation_interval = 0.001;
+// Transient CPU data for the frame in flight, released once it has finished.
+auto const frame_arena_size = size_t{4} << 20;
+// Retirement value of resources the next frame submitted may still use. It
+// is replaced by that frame's value once the render thread learns it.
+auto const next_frame_value = UINT64_MAX;
+auto const present_wait_extensions = array<char const*, 2>{
+		VK_KHR_PRESENT_ID_EXTENSION_NAME,
+		VK_KHR_PRESENT_WAIT_EXTENSION_NAME};
+// GLSL sources for hot reload. The build points this at the source tree.
+#ifndef SHADER_SOURCE_DIR
+#define SHADER_SOURCE_DIR "shaders"
+#endif
+auto const shader_source_dir = SHADER_SOURCE_DIR;
+// Pipeline cache data saved on exit and loaded on the next start.
+auto const pipeline_cache_path = "pipeline_cache.bin";
+auto const pipeline_library_extensions = array<char const*, 2>{
+		VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+		VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME};
+// Parts a graphics pipeline is linked from, in the order of the libraries
+// kept for each.
+auto const pipeline_library_parts =
+		array<vk::GraphicsPipelineLibraryFlagsEXT, 4>{
+				vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface,
+				vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders,
+				vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader,
+				vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface,
+		};
+auto const descriptor_buffer_extensions =
+		array<char const*, 1>{VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME};
+auto const descriptor_buffer_usage =
+		vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT |
+		vk::BufferUsageFlagBits::eSamplerDescriptorBufferEXT |
+		vk::BufferUsageFlagBits::eShaderDeviceAddress;
+// Copies of the scene set in the descriptor buffer ring.
+auto const descriptor_ring_slots = size_t{2};
+// Longest a paced frame waits for the previous one to reach the display, in
+// nanoseconds, and how much later it starts after each frame that made its
+// refresh, in seconds.
+auto const present_wait_timeout = uint64_t{100'000'000};
+auto const pacing_step = 0.0001;
+// In render-on-demand mode, the longest the main thread blocks on events
+// while nothing changes, and the frame interval while the window is
+// unfocused, in seconds.
+auto const idle_timeout = 0.5;
+auto const background_interval = 0.1;
+// Threads compiling pipelines in the background.
+auto const compile_threads = 2u;
 
 // NOLINTNEXTLINE
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
@@ -113,11 +196,84 @@ auto read_file(path const& file_name) -> vector<char>
 	return buffer;
 }
 
+// Reads the file on a job thread, where the awaiting coroutine resumes.
+auto read_file_async(JobSystem& jobs, path file_name) -> Task<vector<char>>
+{
+	co_await resume_on(jobs);
+	co_return read_file(file_name);
+}
+
+enum class CullingMode {
+	none,
+	cpu,
+	gpu,
+};
+
+class Settings
+{
+ public:
+	bool enable_layers = true;
+	vk::PresentModeKHR present_mode = vk::PresentModeKHR::eFifo;
+	uint32_t object_count = 1;
+	CullingMode culling = CullingMode::none;
+	bool occlusion_culling = false;
+	// Cull on a compute-only queue into one of two copies of the draw lists,
+	// so culling for a frame overlaps the previous frame's draws.
+	bool async_compute = false;
+	bool prerecord = false;
+	// Threads in the job system, including the main thread.
+	uint32_t job_threads = 1;
+	// Secondary command buffers recorded in parallel as jobs, or zero to
+	// record everything into the primary command buffer.
+	uint32_t record_threads = 0;
+	bool benchmark_recording = false;
+	// Draw into a hidden window and fail if frames allocate after warm-up.
+	bool benchmark_allocations = false;
+	// Report heap allocations per frame and the frame arena's peak along with
+	// the frame rate.
+	bool report_allocations = false;
+	// Draw on a thread of its own while the main thread handles events, and
+	// optionally hand submission and presentation to a third thread.
+	bool render_thread = false;
+	bool submit_thread = false;
+	// Tag presents with ids and pace frame starts by when the previous frame
+	// reached the display.
+	bool present_wait = false;
+	// Frames started per second, or zero for as many as presentation allows.
+	uint32_t target_fps = 0;
+	// Sample input and update the uniforms after acquiring the image, just
+	// before recording, instead of at the start of the frame.
+	bool late_latch = false;
+	// Back the frame arena with huge pages where the system provides them.
+	bool huge_pages = false;
+	// Link graphics pipelines from separately compiled libraries when the
+	// device supports it, so that new combinations of known shaders and state
+	// are usable on first request.
+	bool pipeline_library = true;
+	// Compare first-use latency and draw cost of monolithic and linked
+	// pipelines.
+	bool benchmark_pipelines = false;
+	// Recompile vertex and fragment shaders when their sources change and swap
+	// in the pipelines using them, reporting GPU render times.
+	bool hot_reload = false;
+	// Write the scene's descriptors into a mapped descriptor buffer ring
+	// instead of allocating a descriptor set, where supported.
+	bool descriptor_buffer = false;
+	// Compare the CPU cost of updating descriptor sets with writing
+	// descriptors into a descriptor buffer.
+	bool benchmark_descriptors = false;
+	// Only draw when the image would change, block on events while the window
+	// is minimized or the animation paused, and slow down while unfocused.
+	bool on_demand = false;
+};
+
 class QueueFamilyIndices
 {
  public:
 	optional<uint32_t> graphics_family;
 	optional<uint32_t> present_family;
+	// Family without graphics support, for async compute, if there is one.
+	optional<uint32_t> compute_family;
 
 	[[nodiscard]] auto is_complete() const -> bool
 	{
@@ -133,6 +289,62 @@ class SwapChainSupportDetails
 	vector<vk::PresentModeKHR> present_modes;
 };
 
+using DeviceFeatures = vk::StructureChain<
+		vk::PhysicalDeviceFeatures2,
+		vk::PhysicalDeviceVulkan12Features,
+		vk::PhysicalDevicePresentIdFeaturesKHR,
+		vk::PhysicalDevicePresentWaitFeaturesKHR,
+		vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT,
+		vk::PhysicalDeviceDescriptorBufferFeaturesEXT>;
+
+// What device selection and setup need to know about a physical device,
+// queried once instead of by every check.
+class DeviceInfo
+{
+ public:
+	vk::PhysicalDeviceProperties properties;
+	// Only the limits; pNext is cleared.
+	vk::PhysicalDeviceVulkan12Properties vulkan12_properties;
+	vk::PhysicalDeviceDescriptorBufferPropertiesEXT descriptor_buffer_properties;
+	vk::PhysicalDeviceMemoryProperties memory_properties;
+	vector<vk::QueueFamilyProperties> queue_families;
+	vector<vk::ExtensionProperties> extensions;
+	DeviceFeatures features;
+
+	[[nodiscard]] auto has_extension(char const* name) const -> bool
+	{
+		return std::ranges::any_of(extensions, [name](auto const& extension) {
+			return strcmp(extension.extensionName, name) == 0;
+		});
+	}
+};
+
+// Wall-clock durations of named startup steps, printed as one breakdown.
+class StartupTimes
+{
+ public:
+	template <typename Function>
+	auto time(char const* step, Function&& function) -> void
+	{
+		auto start = glfwGetTime();
+		std::forward<Function>(function)();
+		_steps.emplace_back(step, glfwGetTime() - start);
+	}
+
+	auto print_steps() const -> void
+	{
+		auto total = 0.0;
+		for (auto const& [step, duration] : _steps) {
+			print("  {:<32} {:8.3f} ms\n", step, 1000.0 * duration);
+			total += duration;
+		}
+		print("startup: {:.3f} ms in {} steps\n", 1000.0 * total, _steps.size());
+	}
+
+ private:
+	vector<std::pair<char const*, double>> _steps;
+};
+
 class Vertex
 {
  public:
@@ -175,6 +387,141 @@ class Vertex
 	}
 };
 
+// Feature toggles of the scene shaders, passed as specialization constants so
+// that each pipeline only keeps the paths it uses. The constant ids are the
+// order of the members; booleans are 32 bits wide, as SPIR-V requires.
+struct ShaderFeatures {
+	// Fragment shader: sample the texture, tint with the vertex color, and
+	// discard fragments with alpha below the cutoff.
+	VkBool32 texture = VK_TRUE;
+	VkBool32 vertex_color = VK_FALSE;
+	VkBool32 alpha_test = VK_FALSE;
+	float alpha_cutoff = 0.5f;
+	// Vertex shader: apply the per-draw model matrix, and scale positions
+	// stored as normalized integers back to model units.
+	VkBool32 model_matrix = VK_TRUE;
+	VkBool32 quantized_positions = VK_FALSE;
+	float position_scale = 1.0f;
+
+	auto operator==(ShaderFeatures const& other) const -> bool = default;
+
+	static auto map_entries() -> array<vk::SpecializationMapEntry, 7>
+	{
+		auto entry = [](uint32_t id, uint32_t offset) {
+			return vk::SpecializationMapEntry{
+					.constantID = id,
+					.offset = offset,
+					.size = 4,
+			};
+		};
+		return array<vk::SpecializationMapEntry, 7>{
+				entry(0, offsetof(ShaderFeatures, texture)),
+				entry(1, offsetof(ShaderFeatures, vertex_color)),
+				entry(2, offsetof(ShaderFeatures, alpha_test)),
+				entry(3, offsetof(ShaderFeatures, alpha_cutoff)),
+				entry(4, offsetof(ShaderFeatures, model_matrix)),
+				entry(5, offsetof(ShaderFeatures, quantized_positions)),
+				entry(6, offsetof(ShaderFeatures, position_scale)),
+		};
+	}
+};
+
+// Workgroup size of a compute shader, as specialization constants 0 and 1,
+// so that it always matches the group counts dispatched.
+struct GroupSize {
+	uint32_t x;
+	uint32_t y;
+
+	static auto map_entries() -> array<vk::SpecializationMapEntry, 2>
+	{
+		return array<vk::SpecializationMapEntry, 2>{
+				vk::SpecializationMapEntry{
+						.constantID = 0,
+						.offset = offsetof(GroupSize, x),
+						.size = sizeof(uint32_t),
+				},
+				vk::SpecializationMapEntry{
+						.constantID = 1,
+						.offset = offsetof(GroupSize, y),
+						.size = sizeof(uint32_t),
+				},
+		};
+	}
+};
+
+// Everything that tells one graphics pipeline from another. The layout and
+// the dynamic viewport and scissor are shared by all of them. Shaders are
+// named by the paths of their SPIR-V files.
+class PipelineDesc
+{
+ public:
+	std::string_view vert_shader;
+	std::string_view frag_shader;
+	vk::VertexInputBindingDescription vertex_binding =
+			Vertex::binding_description();
+	array<vk::VertexInputAttributeDescription, 3> vertex_attributes =
+			Vertex::attribute_descriptions();
+	vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+	vk::PolygonMode polygon_mode = vk::PolygonMode::eFill;
+	vk::CullModeFlags cull_mode = vk::CullModeFlagBits::eBack;
+	vk::FrontFace front_face = vk::FrontFace::eCounterClockwise;
+	bool depth_test = true;
+	bool depth_write = true;
+	vk::CompareOp depth_compare = vk::CompareOp::eLess;
+	bool blend = false;
+	vk::Format color_format = vk::Format::eUndefined;
+	vk::Format depth_format = vk::Format::eUndefined;
+	ShaderFeatures features;
+
+	auto operator==(PipelineDesc const& other) const -> bool = default;
+};
+
+auto hash_combine(size_t seed, size_t value) -> size_t
+{
+	return seed ^ (value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
+}
+
+// -0.0f and 0.0f compare equal but have different bits, so both hash as zero.
+auto hash_float(float value) -> size_t
+{
+	return std::hash<float>{}(value == 0.0f ? 0.0f : value);
+}
+
+class PipelineDescHash
+{
+ public:
+	auto operator()(PipelineDesc const& desc) const -> size_t
+	{
+		auto hash = std::hash<std::string_view>{}(desc.vert_shader);
+		hash = hash_combine(hash, std::hash<std::string_view>{}(desc.frag_shader));
+		hash = hash_combine(hash, desc.vertex_binding.stride);
+		for (auto const& attribute : desc.vertex_attributes) {
+			hash = hash_combine(hash, attribute.location);
+			hash = hash_combine(hash, static_cast<size_t>(attribute.format));
+			hash = hash_combine(hash, attribute.offset);
+		}
+		hash = hash_combine(hash, static_cast<size_t>(desc.topology));
+		hash = hash_combine(hash, static_cast<size_t>(desc.polygon_mode));
+		hash = hash_combine(hash, static_cast<VkCullModeFlags>(desc.cull_mode));
+		hash = hash_combine(hash, static_cast<size_t>(desc.front_face));
+		hash = hash_combine(hash, desc.depth_test);
+		hash = hash_combine(hash, desc.depth_write);
+		hash = hash_combine(hash, static_cast<size_t>(desc.depth_compare));
+		hash = hash_combine(hash, desc.blend);
+		hash = hash_combine(hash, static_cast<size_t>(desc.color_format));
+		hash = hash_combine(hash, static_cast<size_t>(desc.depth_format));
+		auto const& features = desc.features;
+		hash = hash_combine(hash, features.texture);
+		hash = hash_combine(hash, features.vertex_color);
+		hash = hash_combine(hash, features.alpha_test);
+		hash = hash_combine(hash, hash_float(features.alpha_cutoff));
+		hash = hash_combine(hash, features.model_matrix);
+		hash = hash_combine(hash, features.quantized_positions);
+		hash = hash_combine(hash, hash_float(features.position_scale));
+		return hash;
+	}
+};
+
 class BufferMemory
 {
  public:
@@ -189,10 +536,159 @@ class ImageMemory
 	vk::UniqueDeviceMemory memory;
 };
 
+// Timeline semaphore shared by every submission to one queue. Each submission
+// signals a value of its own, so the CPU can wait for exactly the work it
+// depends on.
+class QueueTimeline
+{
+ public:
+	vk::UniqueSemaphore semaphore;
+	// Last value handed to a submission. Values are reserved and submitted in
+	// the same order, under the queue's mutex.
+	uint64_t reserved = 0;
+};
+
+// Resources that the GPU may still be using, destroyed once the timeline
+// reaches the value of the last submission using them.
+class RetiredResources
+{
+ public:
+	uint64_t value;
+	BufferMemory buffer;
+	vk::UniqueCommandBuffer commands;
+	vk::UniqueSwapchainKHR swapchain;
+};
+
+// What GPU culling reads and writes for one frame. With async compute there
+// are two copies, so culling for the next frame fills one while the current
+// frame still draws from the other. `frame_value` is the graphics timeline
+// value of the last frame that drew from the copy, which culling into it
+// waits for, and `compute_value` that of the culling that last filled it.
+// Scratch memory for recording the frame comes from the copy's arena, which
+// is only reset once `frame_value` has passed.
+class CullFrame
+{
+ public:
+	BufferMemory uniform_buffer;
+	void* uniform_data = nullptr;
+	BufferMemory draw_buffer;
+	void* draw_data = nullptr;
+	BufferMemory draw_count_buffer;
+	void* draw_count_data = nullptr;
+	BufferMemory visibility_buffer;
+	BufferMemory statistics_buffer;
+	void* statistics_data = nullptr;
+	vk::DescriptorSet descriptor_set;
+	vk::UniqueCommandBuffer compute_buffer;
+	uint64_t frame_value = 0;
+	uint64_t compute_value = 0;
+	std::unique_ptr<Arena> arena;
+};
+
+// Result of a background pipeline compilation, with how long it took on its
+// thread, in seconds.
+class CompiledPipeline
+{
+ public:
+	vk::UniquePipeline pipeline;
+	double compile_time;
+};
+
+// A pipeline still compiling, which fills its cache entry once it is done.
+// Until then, draws fall back to a generic pipeline.
+class PendingPipeline
+{
+ public:
+	PipelineDesc const* desc;
+	vk::UniquePipeline* target;
+	double queue_time;
+	Task<CompiledPipeline> task;
+};
+
+// How much of the scene set has been written into a slot of the descriptor
+// buffer ring. The bindless tables only grow, so new entries are appended to
+// each slot the next time it is used.
+class DescriptorSlot
+{
+ public:
+	bool uniform = false;
+	size_t buffers = 0;
+	size_t textures = 0;
+};
+
+// A changed shader source being compiled to SPIR-V, by file name.
+class PendingShader
+{
+ public:
+	std::string name;
+	Task<bool> task;
+};
+
+// Per-frame data. `view_proj` is combined once on the CPU so the vertex
+// shader only applies it and the per-draw model matrix; `frustum` holds the
+// clip planes in the model space of the scene draw.
 struct UniformBufferObject {
+	glm::mat4 view_proj;
+	Frustum frustum;
+};
+
+// Per-draw data, passed as push constants. `objects` is the index of the
+// object buffer in the bindless buffer table.
+struct DrawConstants {
 	glm::mat4 model;
+	uint32_t objects;
+};
+
+// Per-object scene data shared by the vertex shader and the culling pass.
+// `offset` translates the mesh, `texture_index` selects its entry in the
+// bindless texture table, and `bounds` is the resulting bounding sphere
+// (center, radius) in model space. Laid out as std430.
+struct ObjectData {
+	glm::vec3 offset;
+	uint32_t texture_index;
+	glm::vec4 bounds;
+};
+static_assert(sizeof(ObjectData) == 32);
+
+enum class CullPhase : uint32_t {
+	frustum,
+	early,
+	late,
+};
+
+struct CullConstants {
+	glm::mat4 model;
+	uint32_t object_count;
+	uint32_t index_count;
+	CullPhase phase;
+};
+
+// Simulation state the main thread hands to the renderer each tick.
+struct FrameSnapshot {
 	glm::mat4 view;
-	glm::mat4 proj;
+};
+
+// A recorded frame for the submit thread to submit and present.
+struct SubmitRequest {
+	vk::CommandBuffer buffer;
+	uint32_t image_index;
+	// Compute timeline value the draws wait for, or zero without async compute.
+	uint64_t compute_value;
+	bool stop;
+};
+
+struct HizConstants {
+	uint32_t width;
+	uint32_t height;
+	uint32_t scale;
+};
+
+class DecodedImage
+{
+ public:
+	std::unique_ptr<stbi_uc, void (*)(void*)> pixels{nullptr, stbi_image_free};
+	uint32_t width = 0;
+	uint32_t height = 0;
 };
 
 class GLFWWrapper
@@ -230,42 +726,147 @@ class GLFWWrapper
 class Application
 {
  public:
-	void run()
+	// Returns false if a benchmark failed.
+	auto run() -> bool
 	{
+		_launch_time = glfwGetTime();
 		init_window();
 		init_vulkan();
+		if (_settings.benchmark_recording) {
+			benchmark_recording();
+			return true;
+		}
+		if (_settings.benchmark_allocations) {
+			return benchmark_allocations();
+		}
+		if (_settings.benchmark_pipelines) {
+			benchmark_pipelines();
+			return true;
+		}
+		if (_settings.benchmark_descriptors) {
+			benchmark_descriptors();
+			return true;
+		}
 		loop();
+		save_pipeline_cache();
+		return true;
 	}
 
-	Application(bool enable_layers, vk::PresentModeKHR present_mode)
-			: _layers_enabled{enable_layers}, _present_mode{present_mode} {};
+	explicit Application(Settings const& settings)
+			: _settings{settings},
+				_jobs{settings.job_threads},
+				_limiter{settings.target_fps} {};
 
  private:
-	bool _layers_enabled;
-	vk::PresentModeKHR _present_mode;
+	Settings _settings;
+	JobSystem _jobs;
 	GLFWWrapper& _glfw = GLFWWrapper::instance();
 	GLFWwindow* _window = nullptr;
 	vk::DynamicLoader _loader{};
 	vk::UniqueInstance _instance;
 	vk::UniqueSurfaceKHR _surface;
 	vk::PhysicalDevice _physical_device;
+	DeviceInfo _device_info;
 	QueueFamilyIndices _queue_familes;
 	SwapChainSupportDetails _swapchain_details;
 	vk::UniqueDevice _device;
 	vk::Queue _graphics_queue;
 	vk::Queue _present_queue;
+	vk::Queue _compute_queue;
 	vk::UniqueSwapchainKHR _swapchain;
 	vector<vk::Image> _swapchain_images;
 	vk::Format _swapchain_image_format{vk::Format::eUndefined};
 	vk::Extent2D _swapchain_extent;
 	vector<vk::UniqueImageView> _image_views;
+	// Set on resizes and when presentation reports the swapchain out of date,
+	// from whichever thread noticed; a render thread waits on it while the
+	// window is minimized. The framebuffer size is published by the main
+	// thread, which alone may query it, as width << 32 | height.
+	std::atomic<bool> _swapchain_dirty{false};
+	std::atomic<uint64_t> _framebuffer_size{};
 	vk::UniqueDescriptorSetLayout _descriptor_set_layout;
 	vk::UniquePipelineLayout _pipeline_layout;
-	vk::UniquePipeline _graphics_pipeline;
+	// Every pipeline is created through the shared cache. Graphics pipelines
+	// are kept by description and compiled in the background on first use,
+	// and the fallback, specialized to shade with vertex colors only, stands in
+	// for them until then. The map is only used by the thread drawing frames.
+	vk::UniquePipelineCache _pipeline_cache;
+	// With pipeline libraries, the part of each pipeline in
+	// `pipeline_library_parts` order, by the fields of the description that
+	// part depends on. Background compilations add to them, hence the mutex.
+	std::mutex _library_mutex;
+	array<
+			std::unordered_map<PipelineDesc, vk::UniquePipeline, PipelineDescHash>,
+			pipeline_library_parts.size()>
+			_libraries;
+	std::unordered_map<PipelineDesc, vk::UniquePipeline, PipelineDescHash>
+			_pipelines;
+	// The scene's pipeline is looked up every frame, so only resolving a
+	// description other than the last one counts as a hit or miss.
+	uint64_t _pipeline_hits{};
+	uint64_t _pipeline_misses{};
+	uint64_t _pipelines_linked{};
+	std::optional<PipelineDesc> _resolved_desc;
+	// Lives in the map like any other pipeline, so hot reload rebuilds it.
+	vk::UniquePipeline const* _fallback_pipeline = nullptr;
+	PipelineDesc _scene_desc;
+	// Looked up once per frame, before recording.
+	vk::Pipeline _scene_pipeline;
+	vk::UniqueDescriptorSetLayout _cull_set_layout;
+	vk::UniquePipelineLayout _cull_pipeline_layout;
+	vk::UniquePipeline _cull_pipeline;
+	vk::UniqueDescriptorSetLayout _hiz_set_layout;
+	vk::UniquePipelineLayout _hiz_pipeline_layout;
+	vk::UniquePipeline _hiz_pipeline;
+	// Libraries replaced by hot reloads. Pipelines linked from them may still
+	// be drawing, so they are kept until shutdown.
+	vector<vk::UniquePipeline> _stale_libraries;
+	optional<ShaderWatcher> _shader_watcher;
+	// Destroyed before the pending tasks, after finishing them.
+	vector<std::unique_ptr<PendingPipeline>> _pending_pipelines;
+	vector<std::unique_ptr<PendingShader>> _pending_shaders;
+	BackgroundThreads _background{compile_threads};
 	vk::UniqueCommandPool _command_pool;
 	vk::UniqueCommandBuffer _command_buffer;
+	// Culling commands for the compute queue are recorded once per copy of the
+	// culling resources and submitted every frame.
+	vk::UniqueCommandPool _compute_pool;
+	QueueTimeline _compute_timeline;
+	// Culling resources by copy, the copy the next frame culls into and the one
+	// the latest submitted frame drew from. With async compute, the next
+	// frame's culling may be submitted before the previous frame has finished,
+	// which `_culling_submitted` records until a frame draws from it.
+	vector<CullFrame> _cull_frames;
+	size_t _cull_frame = 0;
+	size_t _last_cull_frame = 0;
+	bool _culling_submitted = false;
+	// Start and end timestamps of the culling and of the frames on the graphics
+	// queue, to measure how much culling overlaps the frame before its own.
+	vk::UniqueQueryPool _timestamp_pool;
+	double _timestamp_period{};
+	double _compute_time{};
+	double _graphics_time{};
+	double _overlap_time{};
+	array<uint64_t, 2> _previous_render{};
+	vector<vk::UniqueCommandBuffer> _prerecorded_buffers;
+	// Pre-recorded command buffers bake in the swapchain images, attachments,
+	// pipelines, object count and pushed model matrix. Anything that changes
+	// those must set this flag so they are recorded again before the next
+	// submission.
+	bool _commands_dirty = true;
+	vector<vk::UniqueCommandPool> _record_pools;
+	vector<vk::UniqueCommandBuffer> _secondary_buffers;
+	double _record_time{};
 	ImageMemory _depth_image;
 	vk::UniqueImageView _depth_image_view;
+	vk::Extent2D _depth_extent;
+	ImageMemory _hiz_image;
+	vk::UniqueImageView _hiz_image_view;
+	vector<vk::UniqueImageView> _hiz_level_views;
+	vk::UniqueSampler _hiz_sampler;
+	vk::UniqueDescriptorPool _hiz_descriptor_pool;
+	vector<vk::DescriptorSet> _hiz_descriptor_sets;
+	DecodedImage _texture;
 	ImageMemory _texture_image;
 	vk::UniqueImageView _texture_image_view;
 	vk::UniqueSampler _texture_sampler;
@@ -273,52 +874,262 @@ class Application
 	BufferMemory _vertex_buffer;
 	vector<uint32_t> _indices;
 	BufferMemory _index_buffer;
+	glm::vec3 _mesh_lower{};
+	glm::vec3 _mesh_upper{};
+	glm::vec4 _mesh_bounds{};
+	vector<ObjectData> _objects;
+	CullingBounds _bounds;
+	vector<uint32_t> _visible;
+	size_t _visible_count{};
+	glm::mat4 _model{1.0f};
+	Frustum _frustum{};
+	BufferMemory _object_buffer;
+	uint64_t _occluded_objects{};
 	BufferMemory _uniform_buffer;
 	void* _uniform_data{};
 	vk::UniqueDescriptorPool _descriptor_pool;
 	vk::DescriptorSet _descriptor_set;
+	// Entries of the bindless tables in the scene set, by index. Entries added
+	// before the set exists are written when it is allocated.
+	vector<vk::DescriptorBufferInfo> _bindless_buffers;
+	vector<vk::DescriptorImageInfo> _bindless_textures;
+	uint32_t _buffer_capacity = 0;
+	uint32_t _texture_capacity = 0;
+	uint32_t _object_buffer_index = 0;
+	bool _descriptor_buffer_supported = false;
+	// With descriptor buffers, the scene set is a slot of the mapped ring
+	// instead of _descriptor_set. Each binding starts at the same offset in
+	// every slot.
+	BufferMemory _descriptor_ring;
+	void* _descriptor_ring_data{};
+	vk::DeviceAddress _descriptor_ring_address{};
+	vk::DeviceSize _descriptor_set_size{};
+	array<vk::DeviceSize, 3> _descriptor_offsets{};
+	vector<DescriptorSlot> _descriptor_slots;
+	size_t _descriptor_slot = 0;
 	vk::UniqueSemaphore _image_free;
 	vk::UniqueSemaphore _render_done_sem;
-	vk::UniqueFence _render_done_fence;
+	// Uploads run on job threads, so submissions to the graphics queue are
+	// serialized by the mutex. Its timeline tells their coroutines when the
+	// copies are done and the frame loop when the previous frame has finished.
+	QueueTimeline _graphics_timeline;
+	std::mutex _queue_mutex;
+	TimelineWaiters _upload_waiters;
+	// The latest frame's timeline value. submit_frame reserves it under the
+	// mutex as it submits, so the timeline signals in submission order, and
+	// publishes it; `_frame_pending` is set until the render thread has read it.
+	uint64_t _frame_value{};
+	std::atomic<uint64_t> _submitted_value{};
+	bool _frame_pending = false;
+	vector<RetiredResources> _retired;
+	double _start_time{};
+	double _fps_base_time{};
+	uint32_t _fps_frames{};
+	uint64_t _fps_allocations{};
+	std::clock_t _fps_cpu_time{};
+	// Window state from the GLFW callbacks, which run on the main thread. The
+	// animation stops at `_pause_time` while paused, and `_paused_time` is the
+	// total it has been held back by.
+	std::atomic<bool> _iconified{false};
+	std::atomic<bool> _focused{true};
+	bool _paused = false;
+	double _pause_time{};
+	double _paused_time{};
+	// Set when the window system lost the contents of the window. The view
+	// last handed to the renderer lets render-on-demand mode tell whether a
+	// new frame would look any different.
+	std::atomic<bool> _redraw{false};
+	glm::mat4 _shown_view{};
+	size_t _frame_arena_peak{};
+	FrameLimiter _limiter;
+	std::atomic<bool> _rendering{true};
+	SpscQueue<FrameSnapshot, 4> _snapshots;
+	SpscQueue<SubmitRequest, 4> _submissions;
+	// Frames handed to and presented by the submit thread. The swapchain is
+	// externally synchronized, so the next image is only acquired once the
+	// previous one has been presented.
+	uint64_t _submitted_frames{};
+	std::atomic<uint64_t> _presented_frames{};
+	// Present id of the latest frame, which is its graphics timeline value, and
+	// when its image was acquired. `_acquire_time` belongs to the frame being
+	// recorded until it is submitted and its id known. The pacing delay and
+	// refresh interval are in seconds.
+	uint64_t _present_id{};
+	double _present_acquire_time{};
+	double _acquire_time{};
+	// Render-on-demand loops skip frames, so the same present is only waited
+	// for once.
+	uint64_t _paced_id{};
+	// When run() started, for reporting the time to the first frame.
+	double _launch_time = 0;
+	bool _first_frame_presented = false;
+	double _last_present_time{};
+	double _refresh_interval{};
+	double _pacing_delay{};
+	double _present_latency{};
+	uint32_t _presents_timed{};
+	uint32_t _missed_intervals{};
 
 	auto init_window() -> void
 	{
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+		if (_settings.benchmark_allocations || _settings.benchmark_pipelines) {
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		}
 		_window = glfwCreateWindow(
 				window_width,
 				window_height,
 				application_name,
 				nullptr,
 				nullptr);
-		glfwSetKeyCallback(_window, glfw_key_callback);
 		glfwSetWindowUserPointer(_window, this);
+		glfwSetKeyCallback(
+				_window,
+				[](GLFWwindow* window, int key, int scancode, int action, int mods) {
+					glfw_key_callback(window, key, scancode, action, mods);
+					if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
+						from_window(window).toggle_pause();
+					}
+				});
+		glfwSetFramebufferSizeCallback(
+				_window,
+				[](GLFWwindow* window, int width, int height) {
+					auto& app = from_window(window);
+					app.publish_framebuffer_size(width, height);
+					app._swapchain_dirty.store(true, std::memory_order_relaxed);
+					app._swapchain_dirty.notify_one();
+				});
+		glfwSetWindowIconifyCallback(_window, [](GLFWwindow* window, int iconified) {
+			from_window(window)._iconified.store(
+					iconified == GLFW_TRUE,
+					std::memory_order_relaxed);
+		});
+		glfwSetWindowFocusCallback(_window, [](GLFWwindow* window, int focused) {
+			from_window(window)._focused.store(
+					focused == GLFW_TRUE,
+					std::memory_order_relaxed);
+		});
+		glfwSetWindowRefreshCallback(_window, [](GLFWwindow* window) {
+			from_window(window)._redraw.store(true, std::memory_order_relaxed);
+		});
+		auto width = int{};
+		auto height = int{};
+		glfwGetFramebufferSize(_window, &width, &height);
+		publish_framebuffer_size(width, height);
+	}
+
+	static auto from_window(GLFWwindow* window) -> Application&
+	{
+		return *static_cast<Application*>(glfwGetWindowUserPointer(window));
+	}
+
+	auto toggle_pause() -> void
+	{
+		_paused = !_paused;
+		if (_paused) {
+			_pause_time = glfwGetTime();
+		} else {
+			_paused_time += glfwGetTime() - _pause_time;
+		}
+	}
+
+	auto publish_framebuffer_size(int width, int height) -> void
+	{
+		_framebuffer_size.store(
+				uint64_t{static_cast<uint32_t>(width)} << 32 |
+						static_cast<uint32_t>(height),
+				std::memory_order_relaxed);
 	}
 
+	// Each step is timed, and the breakdown printed before the first frame.
 	auto init_vulkan() -> void
 	{
-		init_loader();
-		create_instance();
-		create_surface();
-		pick_physical_device();
-		create_logical_device();
-		create_swapchain();
-		create_image_views();
-		create_descriptor_set_layout();
-		create_graphics_pipeline();
-		create_command_pool();
-		create_command_buffers();
-		create_depth_resources();
-		create_texture_image();
-		create_texture_image_view();
-		create_texture_sampler();
-		load_model();
-		create_vertex_buffer();
-		create_index_buffer();
-		create_uniform_buffer();
-		create_descriptor_pool();
-		create_descriptor_sets();
-		create_sync_objects();
+		auto times = StartupTimes{};
+		auto decoding = decode_assets();
+		times.time("decode_assets (start)", [&] { decoding.start(); });
+		times.time("init_loader", [this] { init_loader(); });
+		times.time("create_instance", [this] { create_instance(); });
+		times.time("create_surface", [this] { create_surface(); });
+		times.time("pick_physical_device", [this] { pick_physical_device(); });
+		times.time("create_logical_device", [this] { create_logical_device(); });
+		times.time("create_swapchain", [this] { create_swapchain(); });
+		times.time("create_image_views", [this] { create_image_views(); });
+		times.time("create_descriptor_set_layouts", [this] {
+			create_descriptor_set_layout();
+			create_cull_descriptor_set_layout();
+			create_hiz_descriptor_set_layout();
+		});
+		times.time("create_pipeline_cache", [this] { create_pipeline_cache(); });
+		times.time("create_graphics_pipelines", [this] {
+			create_graphics_pipelines();
+		});
+		if (_settings.hot_reload) {
+			times.time("watch_shaders", [this] {
+				_shader_watcher.emplace(shader_source_dir, "shaders");
+			});
+		}
+		times.time("create_cull_pipeline", [this] { create_cull_pipeline(); });
+		times.time("create_hiz_pipeline", [this] { create_hiz_pipeline(); });
+		times.time("create_command_pool", [this] { create_command_pool(); });
+		times.time("create_command_buffers", [this] { create_command_buffers(); });
+		times.time("create_depth_resources", [this] { create_depth_resources(); });
+		times.time("create_hiz_resources", [this] { create_hiz_resources(); });
+		times.time("create_timelines", [this] { create_timelines(); });
+		times.time("decode_assets (wait)", [&] {
+			wait_until_done(_jobs, decoding, [] {});
+		});
+		times.time("upload_assets", [this] {
+			auto uploading = upload_assets();
+			sync_wait(_jobs, uploading, [this] { poll_uploads(); });
+		});
+		times.time("create_texture_image_view", [this] {
+			create_texture_image_view();
+		});
+		times.time("create_texture_sampler", [this] { create_texture_sampler(); });
+		times.time("create_objects", [this] { create_objects(); });
+		times.time("create_object_buffers", [this] { create_object_buffers(); });
+		times.time("create_uniform_buffer", [this] { create_uniform_buffer(); });
+		times.time("create_descriptor_pool", [this] { create_descriptor_pool(); });
+		times.time("create_descriptor_sets", [this] { create_descriptor_sets(); });
+		times.time("create_sync_objects", [this] { create_sync_objects(); });
+		times.time("create_timestamp_queries", [this] {
+			create_timestamp_queries();
+		});
+		if (_settings.async_compute) {
+			times.time("record_compute_commands", [this] {
+				record_compute_commands();
+			});
+		}
+		times.print_steps();
+	}
+
+	// Reads and decodes the texture and the model on job threads, overlapped
+	// with the main thread setting up Vulkan.
+	auto decode_assets() -> Task<>
+	{
+		auto texture = load_texture(texture_path);
+		auto model = load_model();
+		co_await when_all(texture, model);
+		_texture = texture.result();
+	}
+
+	auto upload_assets() -> Task<>
+	{
+		auto texture = upload_texture(_texture);
+		auto vertices = upload(
+				_vertices.data(),
+				sizeof(Vertex) * _vertices.size(),
+				vk::BufferUsageFlagBits::eVertexBuffer);
+		auto indices = upload(
+				_indices.data(),
+				sizeof(_indices[0]) * _indices.size(),
+				vk::BufferUsageFlagBits::eIndexBuffer);
+		co_await when_all(texture, vertices, indices);
+		_texture_image = texture.result();
+		_vertex_buffer = vertices.result();
+		_index_buffer = indices.result();
+		_texture.pixels.reset();
 	}
 
 	auto init_loader() -> void
@@ -357,7 +1168,7 @@ class Application
 	[[nodiscard]] auto supported_layers() const -> vector<char const*>
 	{
 		auto supported_layers = vector<char const*>();
-		if (!_layers_enabled) {
+		if (!_settings.enable_layers) {
 			return supported_layers;
 		}
 		auto properties = check(vk::enumerateInstanceLayerProperties());
@@ -388,35 +1199,115 @@ class Application
 		_surface = vk::UniqueSurfaceKHR(surface, _instance.get());
 	}
 
+	// Probes every device on its own thread, so that the round trips to the
+	// driver for each one overlap whatever --job-threads is, and keeps what was
+	// read about the winner.
 	auto pick_physical_device() -> void
 	{
+		class Candidate
+		{
+		 public:
+			vk::PhysicalDevice device;
+			DeviceInfo info;
+			QueueFamilyIndices queue_families;
+			SwapChainSupportDetails swapchain_details;
+			uint8_t score = 0;
+		};
 		auto devices = check(_instance->enumeratePhysicalDevices());
-		auto best = 0;
-		for (auto const& device : devices) {
-			auto queue_families = find_queue_families(device);
-			if (!queue_families.is_complete()) {
-				continue;
-			}
-			auto swapchain_details = swapchain_support(device);
-			auto score =
-					device_suitability(device, queue_families, swapchain_details);
-			if (score > best) {
-				_physical_device = device;
-				_queue_familes = queue_families;
-				_swapchain_details = swapchain_details;
-				best = score;
+		auto candidates = vector<Candidate>(devices.size());
+		auto probe = [&](size_t i) {
+			auto& candidate = candidates[i];
+			candidate.device = devices[i];
+			candidate.info = query_device_info(devices[i]);
+			candidate.queue_families =
+					find_queue_families(devices[i], candidate.info);
+			if (!candidate.queue_families.is_complete()) {
+				return;
 			}
+			candidate.swapchain_details = swapchain_support(devices[i]);
+			candidate.score = device_suitability(
+					candidate.info,
+					candidate.queue_families,
+					candidate.swapchain_details);
+		};
+		auto probes = vector<std::thread>{};
+		probes.reserve(devices.size());
+		for (auto i = size_t{1}; i < devices.size(); ++i) {
+			probes.emplace_back(probe, i);
+		}
+		if (!devices.empty()) {
+			probe(0);
+		}
+		for (auto& thread : probes) {
+			thread.join();
 		}
-		if (_physical_device == vk::PhysicalDevice{nullptr}) {
+		auto best = std::ranges::max_element(
+				candidates,
+				[](auto const& a, auto const& b) { return a.score < b.score; });
+		if (best == candidates.end() || best->score == 0) {
 			fail("Failed to find a suitable physical device.");
 		}
+		_physical_device = best->device;
+		_device_info = std::move(best->info);
+		_queue_familes = best->queue_families;
+		_swapchain_details = std::move(best->swapchain_details);
+	}
+
+	// Structures of extensions the device does not list are unlinked from the
+	// chains before querying, since chaining them would be invalid. Their
+	// fields stay zero, which reads as every feature being unsupported.
+	static auto query_device_info(vk::PhysicalDevice device) -> DeviceInfo
+	{
+		auto info = DeviceInfo{
+				.properties = {},
+				.vulkan12_properties = {},
+				.descriptor_buffer_properties = {},
+				.memory_properties = device.getMemoryProperties(),
+				.queue_families = device.getQueueFamilyProperties(),
+				.extensions = check(device.enumerateDeviceExtensionProperties()),
+				.features = {},
+		};
+		auto descriptor_buffer =
+				info.has_extension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME);
+		auto properties = vk::StructureChain<
+				vk::PhysicalDeviceProperties2,
+				vk::PhysicalDeviceVulkan12Properties,
+				vk::PhysicalDeviceDescriptorBufferPropertiesEXT>{};
+		if (!descriptor_buffer) {
+			properties.unlink<vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+		}
+		device.getProperties2(&properties.get<vk::PhysicalDeviceProperties2>());
+		info.properties =
+				properties.get<vk::PhysicalDeviceProperties2>().properties;
+		info.vulkan12_properties =
+				properties.get<vk::PhysicalDeviceVulkan12Properties>();
+		info.vulkan12_properties.pNext = nullptr;
+		info.descriptor_buffer_properties =
+				properties.get<vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+		info.descriptor_buffer_properties.pNext = nullptr;
+		auto& features = info.features;
+		if (!info.has_extension(VK_KHR_PRESENT_ID_EXTENSION_NAME)) {
+			features.unlink<vk::PhysicalDevicePresentIdFeaturesKHR>();
+		}
+		if (!info.has_extension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+			features.unlink<vk::PhysicalDevicePresentWaitFeaturesKHR>();
+		}
+		if (!info.has_extension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+			features.unlink<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+		}
+		if (!descriptor_buffer) {
+			features.unlink<vk::PhysicalDeviceDescriptorBufferFeaturesEXT>();
+		}
+		device.getFeatures2(&features.get<vk::PhysicalDeviceFeatures2>());
+		return info;
 	}
 
-	auto find_queue_families(vk::PhysicalDevice const& device)
-			-> QueueFamilyIndices
+	auto find_queue_families(
+			vk::PhysicalDevice device,
+			DeviceInfo const& info) -> QueueFamilyIndices
 	{
 		auto indices = QueueFamilyIndices{};
-		auto families = device.getQueueFamilyProperties();
+		auto const& families = info.queue_families;
 		auto idx = uint32_t{};
 		for (auto const& family : families) {
 			if (family.queueFlags & vk::QueueFlagBits::eGraphics) {
@@ -432,6 +1323,15 @@ class Application
 			}
 			idx += 1;
 		}
+		// A family without graphics support usually maps to hardware queues that
+		// run alongside the graphics queue.
+		for (auto i = uint32_t{}; i < families.size(); ++i) {
+			if ((families[i].queueFlags & vk::QueueFlagBits::eCompute) &&
+					!(families[i].queueFlags & vk::QueueFlagBits::eGraphics)) {
+				indices.compute_family.emplace(i);
+				break;
+			}
+		}
 		return indices;
 	}
 
@@ -446,18 +1346,17 @@ class Application
 		return details;
 	}
 
-	auto device_suitability(
-			vk::PhysicalDevice const& device,
+	static auto device_suitability(
+			DeviceInfo const& info,
 			QueueFamilyIndices const& queue_families,
 			SwapChainSupportDetails const& swapchain_details) -> uint8_t
 	{
-		if (!(queue_families.is_complete() && device_extensions_supported(device) &&
+		if (!(queue_families.is_complete() && device_extensions_supported(info) &&
 					swapchain_adequate(swapchain_details) &&
-					device_features_supported(device))) {
+					device_features_supported(info))) {
 			return 0;
 		}
-		auto properties = device.getProperties();
-		switch (properties.deviceType) {
+		switch (info.properties.deviceType) {
 			case vk::PhysicalDeviceType::eDiscreteGpu:
 				return 3;
 			case vk::PhysicalDeviceType::eIntegratedGpu:
@@ -467,70 +1366,149 @@ class Application
 		}
 	}
 
-	auto device_extensions_supported(vk::PhysicalDevice const& device) -> bool
+	static auto device_extensions_supported(DeviceInfo const& info) -> bool
 	{
-		auto available_extensions =
-				check(device.enumerateDeviceExtensionProperties());
-		for (auto const* required : device_extensions) {
-			auto found = false;
-			for (auto const& available : available_extensions) {
-				if (strcmp(available.extensionName, required) == 0) {
-					found = true;
-				}
-			}
-			if (!found) {
-				return false;
-			}
-		}
-		return true;
+		return std::ranges::all_of(device_extensions, [&](auto const* required) {
+			return info.has_extension(required);
+		});
 	}
 
-	auto swapchain_adequate(SwapChainSupportDetails const& details) -> bool
+	static auto swapchain_adequate(SwapChainSupportDetails const& details)
+			-> bool
 	{
 		return !(details.formats.empty() || details.present_modes.empty());
 	}
 
-	auto device_features_supported(vk::PhysicalDevice device) -> bool
+	// Besides anisotropy, the bindless tables need descriptor indexing with
+	// update-after-bind for sampled images and storage buffers.
+	static auto device_features_supported(DeviceInfo const& info) -> bool
 	{
-		auto supported_features = device.getFeatures();
-		return supported_features.samplerAnisotropy == VK_TRUE;
+		auto const& indexing =
+				info.features.get<vk::PhysicalDeviceVulkan12Features>();
+		auto const& features =
+				info.features.get<vk::PhysicalDeviceFeatures2>().features;
+		return features.samplerAnisotropy == VK_TRUE &&
+				features.shaderStorageBufferArrayDynamicIndexing == VK_TRUE &&
+				indexing.shaderSampledImageArrayNonUniformIndexing == VK_TRUE &&
+				indexing.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE &&
+				indexing.descriptorBindingStorageBufferUpdateAfterBind == VK_TRUE &&
+				indexing.descriptorBindingPartiallyBound == VK_TRUE &&
+				indexing.descriptorBindingVariableDescriptorCount == VK_TRUE &&
+				indexing.runtimeDescriptorArray == VK_TRUE;
 	}
 
 	auto create_logical_device() -> void
 	{
+		choose_culling_mode();
+		choose_async_compute();
+		choose_present_wait();
+		choose_pipeline_library();
+		choose_descriptor_buffer();
+		auto extensions = vector<char const*>{
+				device_extensions.begin(),
+				device_extensions.end()};
+		if (_settings.present_wait) {
+			extensions.insert(
+					extensions.end(),
+					present_wait_extensions.begin(),
+					present_wait_extensions.end());
+		}
+		if (_settings.pipeline_library) {
+			extensions.insert(
+					extensions.end(),
+					pipeline_library_extensions.begin(),
+					pipeline_library_extensions.end());
+		}
+		if (_descriptor_buffer_supported) {
+			extensions.insert(
+					extensions.end(),
+					descriptor_buffer_extensions.begin(),
+					descriptor_buffer_extensions.end());
+		}
 		auto queue_priority = 1.0f;
-		auto queue_cis = array<vk::DeviceQueueCreateInfo, 2>{
+		auto queue_cis = array<vk::DeviceQueueCreateInfo, 3>{
 				vk::DeviceQueueCreateInfo{
 						.queueFamilyIndex = _queue_familes.graphics_family.value(),
 						.queueCount = 1,
 						.pQueuePriorities = &queue_priority,
 				},
-				vk::DeviceQueueCreateInfo{
-						.queueFamilyIndex = _queue_familes.present_family.value(),
-						.queueCount = 1,
-						.pQueuePriorities = &queue_priority,
-				},
 		};
-		auto features = vk::PhysicalDeviceFeatures{.samplerAnisotropy = VK_TRUE};
+		auto queue_count = uint32_t{1};
+		if (_queue_familes.present_family != _queue_familes.graphics_family) {
+			queue_cis[queue_count++] = vk::DeviceQueueCreateInfo{
+					.queueFamilyIndex = _queue_familes.present_family.value(),
+					.queueCount = 1,
+					.pQueuePriorities = &queue_priority,
+			};
+		}
+		if (_settings.async_compute) {
+			queue_cis[queue_count++] = vk::DeviceQueueCreateInfo{
+					.queueFamilyIndex = _queue_familes.compute_family.value(),
+					.queueCount = 1,
+					.pQueuePriorities = &queue_priority,
+			};
+		}
+		auto culling = _settings.culling != CullingMode::none;
+		auto features = vk::PhysicalDeviceFeatures{
+				.drawIndirectFirstInstance = culling ? VK_TRUE : VK_FALSE,
+				.samplerAnisotropy = VK_TRUE,
+				.shaderStorageBufferArrayDynamicIndexing = VK_TRUE,
+		};
 		auto device_ci = vk::StructureChain<
 				vk::DeviceCreateInfo,
-				vk::PhysicalDeviceDynamicRenderingFeatures>{
+				vk::PhysicalDeviceVulkan12Features,
+				vk::PhysicalDeviceDynamicRenderingFeatures,
+				vk::PhysicalDevicePresentIdFeaturesKHR,
+				vk::PhysicalDevicePresentWaitFeaturesKHR,
+				vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT,
+				vk::PhysicalDeviceDescriptorBufferFeaturesEXT>{
 				vk::DeviceCreateInfo{
-						.queueCreateInfoCount =
-								_queue_familes.graphics_family == _queue_familes.present_family
-								? uint32_t{1}
-								: uint32_t{2},
+						.queueCreateInfoCount = queue_count,
 						.pQueueCreateInfos = queue_cis.data(),
 						.enabledLayerCount = 0,
 						.ppEnabledLayerNames = VK_NULL_HANDLE,
-						.enabledExtensionCount = device_extensions.size(),
-						.ppEnabledExtensionNames = device_extensions.data(),
+						.enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
+						.ppEnabledExtensionNames = extensions.data(),
 						.pEnabledFeatures = &features,
 				},
+				vk::PhysicalDeviceVulkan12Features{
+						.drawIndirectCount = culling ? VK_TRUE : VK_FALSE,
+						.shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+						.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+						.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE,
+						.descriptorBindingPartiallyBound = VK_TRUE,
+						.descriptorBindingVariableDescriptorCount = VK_TRUE,
+						.runtimeDescriptorArray = VK_TRUE,
+						.timelineSemaphore = VK_TRUE,
+						.bufferDeviceAddress =
+								_descriptor_buffer_supported ? VK_TRUE : VK_FALSE,
+				},
 				vk::PhysicalDeviceDynamicRenderingFeatures{
 						.dynamicRendering = VK_TRUE,
 				},
+				vk::PhysicalDevicePresentIdFeaturesKHR{
+						.presentId = VK_TRUE,
+				},
+				vk::PhysicalDevicePresentWaitFeaturesKHR{
+						.presentWait = VK_TRUE,
+				},
+				vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT{
+						.graphicsPipelineLibrary = VK_TRUE,
+				},
+				vk::PhysicalDeviceDescriptorBufferFeaturesEXT{
+						.descriptorBuffer = VK_TRUE,
+				},
 		};
+		if (!_settings.present_wait) {
+			device_ci.unlink<vk::PhysicalDevicePresentIdFeaturesKHR>();
+			device_ci.unlink<vk::PhysicalDevicePresentWaitFeaturesKHR>();
+		}
+		if (!_settings.pipeline_library) {
+			device_ci.unlink<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+		}
+		if (!_descriptor_buffer_supported) {
+			device_ci.unlink<vk::PhysicalDeviceDescriptorBufferFeaturesEXT>();
+		}
 		_device = check(
 				_physical_device.createDeviceUnique(device_ci.get()),
 				"Failed to create a logical device.");
@@ -539,6 +1517,117 @@ class Application
 				_device->getQueue(_queue_familes.graphics_family.value(), 0);
 		_present_queue =
 				_device->getQueue(_queue_familes.present_family.value(), 0);
+		if (_settings.async_compute) {
+			_compute_queue =
+					_device->getQueue(_queue_familes.compute_family.value(), 0);
+		}
+	}
+
+	auto choose_present_wait() -> void
+	{
+		if (!_settings.present_wait) {
+			return;
+		}
+		auto const& features = _device_info.features;
+		if (_device_info.has_extension(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+				_device_info.has_extension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME) &&
+				features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId ==
+						VK_TRUE &&
+				features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>()
+								.presentWait == VK_TRUE) {
+			return;
+		}
+		print(
+				stderr,
+				"WARNING: Present wait is unavailable. "
+				"Frames will not be paced\n");
+		_settings.present_wait = false;
+	}
+
+	// Linking is only an optimization, so its absence is reported only to the
+	// benchmark that compares it.
+	auto choose_pipeline_library() -> void
+	{
+		if (!_settings.pipeline_library) {
+			return;
+		}
+		auto const& features = _device_info.features;
+		if (_device_info.has_extension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+				_device_info.has_extension(
+						VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+				features.get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>()
+								.graphicsPipelineLibrary == VK_TRUE) {
+			return;
+		}
+		if (_settings.benchmark_pipelines) {
+			print(
+					stderr,
+					"WARNING: Graphics pipeline libraries are unavailable. "
+					"Only monolithic pipelines will be measured\n");
+		}
+		_settings.pipeline_library = false;
+	}
+
+	// The benchmark needs the extension even while the scene uses descriptor
+	// sets. Arrays of combined image samplers have to be laid out like other
+	// arrays for the texture table to be written one entry at a time.
+	auto choose_descriptor_buffer() -> void
+	{
+		if (!_settings.descriptor_buffer && !_settings.benchmark_descriptors) {
+			return;
+		}
+		auto const& features = _device_info.features;
+		_descriptor_buffer_supported =
+				_device_info.has_extension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME) &&
+				features.get<vk::PhysicalDeviceDescriptorBufferFeaturesEXT>()
+								.descriptorBuffer == VK_TRUE &&
+				features.get<vk::PhysicalDeviceVulkan12Features>()
+								.bufferDeviceAddress == VK_TRUE &&
+				_device_info.descriptor_buffer_properties
+								.combinedImageSamplerDescriptorSingleArray == VK_TRUE;
+		if (_descriptor_buffer_supported) {
+			return;
+		}
+		print(
+				stderr,
+				"WARNING: Descriptor buffers are unavailable. "
+				"Falling back to descriptor sets\n");
+		_settings.descriptor_buffer = false;
+	}
+
+	auto choose_async_compute() -> void
+	{
+		if (_settings.culling != CullingMode::gpu) {
+			_settings.async_compute = false;
+		}
+		if (!_settings.async_compute || _queue_familes.compute_family.has_value()) {
+			return;
+		}
+		print(
+				stderr,
+				"WARNING: No compute-only queue family. "
+				"Falling back to culling on the graphics queue\n");
+		_settings.async_compute = false;
+	}
+
+	auto choose_culling_mode() -> void
+	{
+		if (_settings.culling == CullingMode::none) {
+			return;
+		}
+		auto const& features = _device_info.features;
+		if (features.get<vk::PhysicalDeviceFeatures2>()
+								.features.drawIndirectFirstInstance == VK_TRUE &&
+				features.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount ==
+						VK_TRUE) {
+			return;
+		}
+		print(
+				stderr,
+				"WARNING: Indirect count draws are unavailable. "
+				"Falling back to drawing every object\n");
+		_settings.culling = CullingMode::none;
+		_settings.occlusion_culling = false;
 	}
 
 	auto create_swapchain() -> void
@@ -565,13 +1654,26 @@ class Application
 				.pQueueFamilyIndices = indices.data(),
 				.preTransform = _swapchain_details.capabilities.currentTransform,
 				.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
-				.presentMode = _present_mode,
+				.presentMode = _settings.present_mode,
 				.clipped = VK_TRUE,
-				.oldSwapchain = VK_NULL_HANDLE,
+				.oldSwapchain = _swapchain.get(),
 		};
-		_swapchain = check(
-				_device->createSwapchainKHRUnique(swapchain_ci),
-				"Failed to create a swapchain.");
+		auto old_swapchain = std::exchange(
+				_swapchain,
+				check(
+						_device->createSwapchainKHRUnique(swapchain_ci),
+						"Failed to create a swapchain."));
+		// The presentation engine may still hold images of the old swapchain,
+		// so it lives until the next frame has finished. Uploads and culling
+		// reserve values too, so the frame's own is only known once submitted.
+		if (old_swapchain) {
+			_retired.push_back(RetiredResources{
+					.value = next_frame_value,
+					.buffer = {},
+					.commands = {},
+					.swapchain = std::move(old_swapchain),
+			});
+		}
 		_swapchain_images = check(_device->getSwapchainImagesKHR(_swapchain.get()));
 		_swapchain_image_format = format.format;
 		_swapchain_extent = extent;
@@ -595,16 +1697,16 @@ class Application
 		if (capabilities.currentExtent != vk::Extent2D{0xFFFFFFFF, 0xFFFFFFFF}) {
 			return capabilities.currentExtent;
 		}
-		auto width = int{};
-		auto height = int{};
-		glfwGetFramebufferSize(_window, &width, &height);
+		auto size = _framebuffer_size.load(std::memory_order_relaxed);
+		auto width = static_cast<uint32_t>(size >> 32);
+		auto height = static_cast<uint32_t>(size);
 		auto extent = vk::Extent2D{
 				.width = clamp(
-						static_cast<uint32_t>(width),
+						width,
 						capabilities.minImageExtent.width,
 						capabilities.maxImageExtent.width),
 				.height = clamp(
-						static_cast<uint32_t>(height),
+						height,
 						capabilities.minImageExtent.height,
 						capabilities.maxImageExtent.height),
 		};
@@ -614,7 +1716,7 @@ class Application
 	auto choose_swapchain_present_mode(span<vk::PresentModeKHR> modes) -> void
 	{
 		for (auto mode : modes) {
-			if (mode == _present_mode) {
+			if (mode == _settings.present_mode) {
 				return;
 			}
 		}
@@ -622,7 +1724,7 @@ class Application
 				stderr,
 				"WARNING: Requested present mode is unavailable. "
 				"Falling back to FIFO\n");
-		_present_mode = vk::PresentModeKHR::eFifo;
+		_settings.present_mode = vk::PresentModeKHR::eFifo;
 	};
 
 	auto create_image_views() -> void
@@ -655,9 +1757,28 @@ class Application
 		}
 	}
 
+	// The scene set is a global bindless table: the uniform buffer, then
+	// arrays of storage buffers and textures that shaders index into. Table
+	// entries may be written while the set is bound, and unused ones are
+	// never read. The texture array is allocated with a variable count, so it
+	// has to be the last binding. Descriptor buffers behave that way without
+	// any binding flags.
 	auto create_descriptor_set_layout() -> void
 	{
-		auto bindings = array<vk::DescriptorSetLayoutBinding, 2>{
+		auto const& limits = _device_info.vulkan12_properties;
+		_buffer_capacity = std::min({
+				bindless_buffer_limit,
+				limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+				limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+		});
+		_texture_capacity = std::min({
+				bindless_texture_limit,
+				limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+				limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+				limits.maxDescriptorSetUpdateAfterBindSampledImages,
+				limits.maxDescriptorSetUpdateAfterBindSamplers,
+		});
+		auto bindings = array<vk::DescriptorSetLayoutBinding, 3>{
 				vk::DescriptorSetLayoutBinding{
 						.binding = 0,
 						.descriptorType = vk::DescriptorType::eUniformBuffer,
@@ -667,78 +1788,544 @@ class Application
 				},
 				vk::DescriptorSetLayoutBinding{
 						.binding = 1,
+						.descriptorType = vk::DescriptorType::eStorageBuffer,
+						.descriptorCount = _buffer_capacity,
+						.stageFlags = vk::ShaderStageFlagBits::eVertex,
+						.pImmutableSamplers = VK_NULL_HANDLE,
+				},
+				vk::DescriptorSetLayoutBinding{
+						.binding = 2,
 						.descriptorType = vk::DescriptorType::eCombinedImageSampler,
-						.descriptorCount = 1,
+						.descriptorCount = _texture_capacity,
 						.stageFlags = vk::ShaderStageFlagBits::eFragment,
 						.pImmutableSamplers = VK_NULL_HANDLE,
 				},
 		};
+		using Flag = vk::DescriptorBindingFlagBits;
+		auto table_flags = Flag::ePartiallyBound | Flag::eUpdateAfterBind;
+		auto binding_flags = array<vk::DescriptorBindingFlags, 3>{
+				vk::DescriptorBindingFlags{},
+				table_flags,
+				table_flags | Flag::eVariableDescriptorCount,
+		};
+		auto layout_flags = vk::DescriptorSetLayoutCreateFlags{
+				vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool};
+		if (_settings.descriptor_buffer) {
+			binding_flags = {};
+			layout_flags =
+					vk::DescriptorSetLayoutCreateFlagBits::eDescriptorBufferEXT;
+		}
+		auto layout_ci = vk::StructureChain<
+				vk::DescriptorSetLayoutCreateInfo,
+				vk::DescriptorSetLayoutBindingFlagsCreateInfo>{
+				vk::DescriptorSetLayoutCreateInfo{
+						.flags = layout_flags,
+						.bindingCount = bindings.size(),
+						.pBindings = bindings.data(),
+				},
+				vk::DescriptorSetLayoutBindingFlagsCreateInfo{
+						.bindingCount = binding_flags.size(),
+						.pBindingFlags = binding_flags.data(),
+				},
+		};
+		_descriptor_set_layout = check(
+				_device->createDescriptorSetLayoutUnique(layout_ci.get()),
+				"Failed to create a descriptor set layout.");
+	}
+
+	auto create_cull_descriptor_set_layout() -> void
+	{
+		auto types = array<vk::DescriptorType, 7>{
+				vk::DescriptorType::eUniformBuffer,
+				vk::DescriptorType::eStorageBuffer,
+				vk::DescriptorType::eStorageBuffer,
+				vk::DescriptorType::eStorageBuffer,
+				vk::DescriptorType::eStorageBuffer,
+				vk::DescriptorType::eCombinedImageSampler,
+				vk::DescriptorType::eStorageBuffer,
+		};
+		auto bindings = array<vk::DescriptorSetLayoutBinding, types.size()>{};
+		for (auto i = uint32_t{}; i < bindings.size(); ++i) {
+			bindings[i] = vk::DescriptorSetLayoutBinding{
+					.binding = i,
+					.descriptorType = types[i],
+					.descriptorCount = 1,
+					.stageFlags = vk::ShaderStageFlagBits::eCompute,
+					.pImmutableSamplers = VK_NULL_HANDLE,
+			};
+		}
 		auto layout_ci = vk::DescriptorSetLayoutCreateInfo{
 				.bindingCount = bindings.size(),
 				.pBindings = bindings.data(),
 		};
-		_descriptor_set_layout = check(
+		_cull_set_layout = check(
 				_device->createDescriptorSetLayoutUnique(layout_ci),
 				"Failed to create a descriptor set layout.");
 	}
 
-	auto create_graphics_pipeline() -> void
+	auto create_hiz_descriptor_set_layout() -> void
 	{
-		auto vert_shader_code = read_file("shaders/shader.vert.spv");
-		auto frag_shader_code = read_file("shaders/shader.frag.spv");
-		auto vert_shader_module = create_shader_module(vert_shader_code);
-		auto frag_shader_module = create_shader_module(frag_shader_code);
-		auto shader_stages = array<vk::PipelineShaderStageCreateInfo, 2>{
-				create_pipeline_shader_info(
-						vert_shader_module.get(),
-						vk::ShaderStageFlagBits::eVertex),
-				create_pipeline_shader_info(
-						frag_shader_module.get(),
-						vk::ShaderStageFlagBits::eFragment)};
-
-		auto vertex_binding_description = Vertex::binding_description();
-		auto vertex_attribute_descriptions = Vertex::attribute_descriptions();
-		auto vertex_input_ci = vk::PipelineVertexInputStateCreateInfo{
-				.vertexBindingDescriptionCount = 1,
-				.pVertexBindingDescriptions = &vertex_binding_description,
-				.vertexAttributeDescriptionCount = vertex_attribute_descriptions.size(),
-				.pVertexAttributeDescriptions = vertex_attribute_descriptions.data(),
-		};
-
-		auto input_assembly_ci = vk::PipelineInputAssemblyStateCreateInfo{
-				.topology = vk::PrimitiveTopology::eTriangleList,
-				.primitiveRestartEnable = VK_FALSE,
+		auto bindings = array<vk::DescriptorSetLayoutBinding, 2>{
+				vk::DescriptorSetLayoutBinding{
+						.binding = 0,
+						.descriptorType = vk::DescriptorType::eCombinedImageSampler,
+						.descriptorCount = 1,
+						.stageFlags = vk::ShaderStageFlagBits::eCompute,
+						.pImmutableSamplers = VK_NULL_HANDLE,
+				},
+				vk::DescriptorSetLayoutBinding{
+						.binding = 1,
+						.descriptorType = vk::DescriptorType::eStorageImage,
+						.descriptorCount = 1,
+						.stageFlags = vk::ShaderStageFlagBits::eCompute,
+						.pImmutableSamplers = VK_NULL_HANDLE,
+				},
 		};
-
-		auto viewport = vk::Viewport{
-				.x = 0,
-				.y = 0,
-				.width = static_cast<float>(_swapchain_extent.width),
-				.height = static_cast<float>(_swapchain_extent.height),
-				.minDepth = 0,
-				.maxDepth = 1,
+		auto layout_ci = vk::DescriptorSetLayoutCreateInfo{
+				.bindingCount = bindings.size(),
+				.pBindings = bindings.data(),
 		};
-		auto scissor = vk::Rect2D{
-				.offset =
-						vk::Offset2D{
-								.x = 0,
-								.y = 0,
+		_hiz_set_layout = check(
+				_device->createDescriptorSetLayoutUnique(layout_ci),
+				"Failed to create a descriptor set layout.");
+	}
+
+	// Starts from the data saved by the previous run, unless its header shows
+	// that another device or driver wrote it.
+	auto create_pipeline_cache() -> void
+	{
+		auto data = vector<char>{};
+		if (std::filesystem::exists(pipeline_cache_path)) {
+			data = read_file(pipeline_cache_path);
+		}
+		if (!pipeline_cache_compatible(data)) {
+			data.clear();
+		}
+		_pipeline_cache = check(
+				_device->createPipelineCacheUnique(vk::PipelineCacheCreateInfo{
+						.initialDataSize = data.size(),
+						.pInitialData = data.data(),
+				}),
+				"Failed to create a pipeline cache.");
+	}
+
+	auto pipeline_cache_compatible(vector<char> const& data) const -> bool
+	{
+		auto header = vk::PipelineCacheHeaderVersionOne{};
+		if (data.size() < sizeof(header)) {
+			return false;
+		}
+		std::memcpy(&header, data.data(), sizeof(header));
+		auto const& properties = _device_info.properties;
+		return header.headerVersion == vk::PipelineCacheHeaderVersion::eOne &&
+				header.vendorID == properties.vendorID &&
+				header.deviceID == properties.deviceID &&
+				header.pipelineCacheUUID == properties.pipelineCacheUUID;
+	}
+
+	auto save_pipeline_cache() -> void
+	{
+		auto data = check(_device->getPipelineCacheData(_pipeline_cache.get()));
+		auto file = std::ofstream(pipeline_cache_path, ios::binary | ios::trunc);
+		file.write(
+				reinterpret_cast<char const*>(data.data()),
+				static_cast<std::streamsize>(data.size()));
+		if (!file) {
+			print(stderr, "WARNING: Failed to save the pipeline cache\n");
+		}
+	}
+
+	// Only the fallback pipeline is compiled before the first frame. The scene
+	// pipeline is requested right away so that it starts compiling.
+	auto create_graphics_pipelines() -> void
+	{
+		create_pipeline_layout();
+		_scene_desc = PipelineDesc{
+				.vert_shader = "shaders/shader.vert.spv",
+				.frag_shader = "shaders/shader.frag.spv",
+				.color_format = _swapchain_image_format,
+				.depth_format = find_depth_format(),
+				.features =
+						ShaderFeatures{
+								.model_matrix =
+										_model == glm::mat4{1.0f} ? VK_FALSE : VK_TRUE,
 						},
-				.extent = _swapchain_extent,
 		};
+		auto fallback_desc = _scene_desc;
+		fallback_desc.features.texture = VK_FALSE;
+		fallback_desc.features.vertex_color = VK_TRUE;
+		auto [fallback, inserted] = _pipelines.try_emplace(
+				fallback_desc,
+				create_graphics_pipeline(fallback_desc));
+		_fallback_pipeline = &fallback->second;
+		_scene_pipeline = find_pipeline(_scene_desc);
+	}
+
+	// Returns the pipeline matching `desc`, or the fallback while it is still
+	// compiling. The first request for a description queues its compilation.
+	// With pipeline libraries, a description whose parts have all been
+	// compiled before is linked right away, and only the optimized link is
+	// left to the background.
+	auto find_pipeline(PipelineDesc const& desc) -> vk::Pipeline
+	{
+		auto [entry, inserted] = _pipelines.try_emplace(desc);
+		if (inserted) {
+			_pipeline_misses += 1;
+			if (_settings.pipeline_library) {
+				auto libraries = find_libraries(desc);
+				if (std::ranges::find(libraries, vk::Pipeline{}) == libraries.end()) {
+					entry->second = link_pipeline(libraries, false);
+					_pipelines_linked += 1;
+				}
+			}
+			queue_graphics_pipeline(entry->first, entry->second);
+		} else if (_resolved_desc != desc) {
+			_pipeline_hits += 1;
+		}
+		_resolved_desc = desc;
+		return entry->second ? entry->second.get() : _fallback_pipeline->get();
+	}
+
+	auto create_pipeline_layout() -> void
+	{
+		auto push_constant_range = vk::PushConstantRange{
+				.stageFlags = vk::ShaderStageFlagBits::eVertex,
+				.offset = 0,
+				.size = sizeof(DrawConstants),
+		};
+		auto pipeline_layout_ci = vk::PipelineLayoutCreateInfo{
+				.setLayoutCount = 1,
+				.pSetLayouts = &_descriptor_set_layout.get(),
+				.pushConstantRangeCount = 1,
+				.pPushConstantRanges = &push_constant_range,
+		};
+		_pipeline_layout = check(
+				_device->createPipelineLayoutUnique(pipeline_layout_ci),
+				"Failed to create a pipeline layout.");
+	}
+
+	// Starts compiling a pipeline on a background thread. It is moved into
+	// `target` by the first frame after it is done. Map entries stay where they
+	// are, so `desc` and `target` may point into the pipeline map.
+	auto queue_graphics_pipeline(
+			PipelineDesc const& desc,
+			vk::UniquePipeline& target) -> void
+	{
+		auto& pending = _pending_pipelines.emplace_back(
+				std::make_unique<PendingPipeline>(PendingPipeline{
+						.desc = &desc,
+						.target = &target,
+						.queue_time = glfwGetTime(),
+						.task = compile_graphics_pipeline(desc),
+				}));
+		pending->task.start();
+	}
+
+	auto compile_graphics_pipeline(PipelineDesc desc) -> Task<CompiledPipeline>
+	{
+		co_await resume_on(_background);
+		auto start = glfwGetTime();
+		auto pipeline = _settings.pipeline_library
+				? link_pipeline(create_libraries(desc), true)
+				: create_graphics_pipeline(desc);
+		co_return CompiledPipeline{
+				.pipeline = std::move(pipeline),
+				.compile_time = glfwGetTime() - start,
+		};
+	}
+
+	// Swaps in the pipelines that finished compiling. Only called once the
+	// previous frame has finished, so nothing still uses a replaced pipeline.
+	auto collect_pipelines() -> void
+	{
+		for (auto i = size_t{}; i < _pending_pipelines.size();) {
+			auto& pending = *_pending_pipelines[i];
+			if (!pending.task.done()) {
+				++i;
+				continue;
+			}
+			// A hot reload may have queued the same pipeline again, and only the
+			// latest request has the current shaders.
+			auto later = std::span{_pending_pipelines}.subspan(i + 1);
+			auto superseded = std::ranges::any_of(later, [&](auto const& other) {
+				return other->target == pending.target;
+			});
+			auto compiled = pending.task.result();
+			if (!superseded) {
+				*pending.target = std::move(compiled.pipeline);
+				print(
+						"pipeline {} + {}: ready after {:.3f} ms, {:.3f} ms compiling\n",
+						pending.desc->vert_shader,
+						pending.desc->frag_shader,
+						1000.0 * (glfwGetTime() - pending.queue_time),
+						1000.0 * compiled.compile_time);
+				_commands_dirty = true;
+			}
+			_pending_pipelines.erase(_pending_pipelines.begin() + i);
+		}
+	}
+
+	// Starts compiling the shader sources that changed since the last frame,
+	// and once one has compiled, recompiles every pipeline and library using
+	// it. Pipelines keep drawing with the old shader until their replacement
+	// is collected at a later frame boundary.
+	auto reload_shaders() -> void
+	{
+		if (!_shader_watcher) {
+			return;
+		}
+		for (auto& name : _shader_watcher->changed()) {
+			if (!name.ends_with(".vert") && !name.ends_with(".frag")) {
+				continue;
+			}
+			auto& pending = _pending_shaders.emplace_back(
+					std::make_unique<PendingShader>(PendingShader{
+							.name = name,
+							.task = compile_shader(name),
+					}));
+			pending->task.start();
+		}
+		for (auto i = size_t{}; i < _pending_shaders.size();) {
+			auto& pending = *_pending_shaders[i];
+			if (!pending.task.done()) {
+				++i;
+				continue;
+			}
+			if (pending.task.result()) {
+				reload_pipelines("shaders/" + pending.name + ".spv");
+			} else {
+				print(stderr, "WARNING: Failed to compile {}\n", pending.name);
+			}
+			_pending_shaders.erase(_pending_shaders.begin() + i);
+		}
+	}
+
+	auto compile_shader(std::string name) -> Task<bool>
+	{
+		co_await resume_on(_background);
+		co_return _shader_watcher->compile(name);
+	}
+
+	auto reload_pipelines(std::string const& shader) -> void
+	{
+		auto uses_shader = [&](PipelineDesc const& desc) {
+			return desc.vert_shader == shader || desc.frag_shader == shader;
+		};
+		{
+			auto lock = std::scoped_lock{_library_mutex};
+			for (auto& libraries : _libraries) {
+				for (auto it = libraries.begin(); it != libraries.end();) {
+					if (uses_shader(it->first)) {
+						_stale_libraries.push_back(std::move(it->second));
+						it = libraries.erase(it);
+					} else {
+						++it;
+					}
+				}
+			}
+		}
+		auto count = 0;
+		for (auto& [desc, pipeline] : _pipelines) {
+			if (uses_shader(desc)) {
+				queue_graphics_pipeline(desc, pipeline);
+				count += 1;
+			}
+		}
+		print("{}: recompiling {} pipelines\n", shader, count);
+	}
+
+	// The fields of `desc` that pipeline library part `part` depends on, with
+	// the rest left at their defaults, so that descriptions differing only
+	// elsewhere share the library.
+	static auto library_key(PipelineDesc const& desc, size_t part)
+			-> PipelineDesc
+	{
+		auto key = PipelineDesc{};
+		switch (part) {
+			case 0:
+				key.vertex_binding = desc.vertex_binding;
+				key.vertex_attributes = desc.vertex_attributes;
+				key.topology = desc.topology;
+				break;
+			case 1:
+				key.vert_shader = desc.vert_shader;
+				key.polygon_mode = desc.polygon_mode;
+				key.cull_mode = desc.cull_mode;
+				key.front_face = desc.front_face;
+				key.features.model_matrix = desc.features.model_matrix;
+				key.features.quantized_positions = desc.features.quantized_positions;
+				key.features.position_scale = desc.features.position_scale;
+				break;
+			case 2:
+				key.frag_shader = desc.frag_shader;
+				key.depth_test = desc.depth_test;
+				key.depth_write = desc.depth_write;
+				key.depth_compare = desc.depth_compare;
+				key.features.texture = desc.features.texture;
+				key.features.vertex_color = desc.features.vertex_color;
+				key.features.alpha_test = desc.features.alpha_test;
+				key.features.alpha_cutoff = desc.features.alpha_cutoff;
+				break;
+			default:
+				key.blend = desc.blend;
+				key.color_format = desc.color_format;
+				key.depth_format = desc.depth_format;
+				break;
+		}
+		return key;
+	}
+
+	// The libraries `desc` would be linked from, or null handles for those
+	// not compiled yet.
+	auto find_libraries(PipelineDesc const& desc)
+			-> array<vk::Pipeline, pipeline_library_parts.size()>
+	{
+		auto libraries = array<vk::Pipeline, pipeline_library_parts.size()>{};
+		auto lock = std::scoped_lock{_library_mutex};
+		for (auto part = size_t{}; part < libraries.size(); ++part) {
+			auto library = _libraries[part].find(library_key(desc, part));
+			if (library != _libraries[part].end()) {
+				libraries[part] = library->second.get();
+			}
+		}
+		return libraries;
+	}
+
+	// Compiles the libraries `desc` needs that do not exist yet, outside the
+	// lock. Should two threads race for the same one, the first to finish
+	// keeps it.
+	auto create_libraries(PipelineDesc const& desc)
+			-> array<vk::Pipeline, pipeline_library_parts.size()>
+	{
+		auto libraries = find_libraries(desc);
+		for (auto part = size_t{}; part < libraries.size(); ++part) {
+			if (libraries[part]) {
+				continue;
+			}
+			auto library = create_graphics_pipeline(
+					library_key(desc, part),
+					pipeline_library_parts[part]);
+			auto lock = std::scoped_lock{_library_mutex};
+			auto [entry, inserted] = _libraries[part].try_emplace(
+					library_key(desc, part),
+					std::move(library));
+			libraries[part] = entry->second.get();
+		}
+		return libraries;
+	}
+
+	// Graphics pipelines, and every library they are linked from, have to say
+	// whether they take their descriptors from descriptor buffers.
+	auto descriptor_pipeline_flags() const -> vk::PipelineCreateFlags
+	{
+		if (!_settings.descriptor_buffer) {
+			return {};
+		}
+		return vk::PipelineCreateFlagBits::eDescriptorBufferEXT;
+	}
+
+	// Fast links skip link-time optimization and take a fraction of the time
+	// compiling would, in exchange for possibly slower draws.
+	auto link_pipeline(
+			array<vk::Pipeline, pipeline_library_parts.size()> const& libraries,
+			bool optimize) -> vk::UniquePipeline
+	{
+		auto flags = descriptor_pipeline_flags();
+		if (optimize) {
+			flags |= vk::PipelineCreateFlagBits::eLinkTimeOptimizationEXT;
+		}
+		auto pipeline_ci = vk::StructureChain<
+				vk::GraphicsPipelineCreateInfo,
+				vk::PipelineLibraryCreateInfoKHR>{
+				vk::GraphicsPipelineCreateInfo{
+						.flags = flags,
+						.layout = _pipeline_layout.get(),
+				},
+				vk::PipelineLibraryCreateInfoKHR{
+						.libraryCount = static_cast<uint32_t>(libraries.size()),
+						.pLibraries = libraries.data(),
+				},
+		};
+		return check(
+				_device->createGraphicsPipelineUnique(
+						_pipeline_cache.get(),
+						pipeline_ci.get()),
+				"Failed to link a graphics pipeline.");
+	}
+
+	// Creates a complete pipeline, or with `parts`, a library holding only
+	// those parts, keeping what optimized links need. Safe to call from any
+	// thread: it only reads state that is fixed once the device has been
+	// created.
+	auto create_graphics_pipeline(
+			PipelineDesc const& desc,
+			vk::GraphicsPipelineLibraryFlagsEXT parts = {}) -> vk::UniquePipeline
+	{
+		using Part = vk::GraphicsPipelineLibraryFlagBitsEXT;
+		auto complete = !parts;
+		auto shader_modules = array<vk::UniqueShaderModule, 2>{};
+		auto shader_stages = array<vk::PipelineShaderStageCreateInfo, 2>{};
+		auto stage_count = uint32_t{};
+		// Both stages share one set of constants, each reading its own ids.
+		auto map_entries = ShaderFeatures::map_entries();
+		auto specialization = vk::SpecializationInfo{
+				.mapEntryCount = map_entries.size(),
+				.pMapEntries = map_entries.data(),
+				.dataSize = sizeof(desc.features),
+				.pData = &desc.features,
+		};
+		auto add_stage = [&](std::string_view file, vk::ShaderStageFlagBits stage) {
+			auto code = read_file(path{file});
+			shader_modules[stage_count] = create_shader_module(code);
+			shader_stages[stage_count] = create_pipeline_shader_info(
+					shader_modules[stage_count].get(),
+					stage,
+					specialization);
+			stage_count += 1;
+		};
+		if (complete || parts & Part::ePreRasterizationShaders) {
+			add_stage(desc.vert_shader, vk::ShaderStageFlagBits::eVertex);
+		}
+		if (complete || parts & Part::eFragmentShader) {
+			add_stage(desc.frag_shader, vk::ShaderStageFlagBits::eFragment);
+		}
+
+		auto vertex_input_ci = vk::PipelineVertexInputStateCreateInfo{
+				.vertexBindingDescriptionCount = 1,
+				.pVertexBindingDescriptions = &desc.vertex_binding,
+				.vertexAttributeDescriptionCount =
+						static_cast<uint32_t>(desc.vertex_attributes.size()),
+				.pVertexAttributeDescriptions = desc.vertex_attributes.data(),
+		};
+
+		auto input_assembly_ci = vk::PipelineInputAssemblyStateCreateInfo{
+				.topology = desc.topology,
+				.primitiveRestartEnable = VK_FALSE,
+		};
+
+		// The viewport and scissor follow the swapchain, so they are set while
+		// recording and resizing never rebuilds the pipeline.
 		auto viewport_ci = vk::PipelineViewportStateCreateInfo{
 				.viewportCount = 1,
-				.pViewports = &viewport,
+				.pViewports = VK_NULL_HANDLE,
 				.scissorCount = 1,
-				.pScissors = &scissor,
+				.pScissors = VK_NULL_HANDLE,
+		};
+		auto dynamic_states = array<vk::DynamicState, 2>{
+				vk::DynamicState::eViewport,
+				vk::DynamicState::eScissor,
+		};
+		auto dynamic_state_ci = vk::PipelineDynamicStateCreateInfo{
+				.dynamicStateCount = dynamic_states.size(),
+				.pDynamicStates = dynamic_states.data(),
 		};
 
 		auto rasterizer_ci = vk::PipelineRasterizationStateCreateInfo{
 				.depthClampEnable = VK_FALSE,
 				.rasterizerDiscardEnable = VK_FALSE,
-				.polygonMode = vk::PolygonMode::eFill,
-				.cullMode = vk::CullModeFlagBits::eBack,
-				.frontFace = vk::FrontFace::eCounterClockwise,
+				.polygonMode = desc.polygon_mode,
+				.cullMode = desc.cull_mode,
+				.frontFace = desc.front_face,
 				.depthBiasEnable = VK_FALSE,
 				.depthBiasConstantFactor = 0,
 				.depthBiasClamp = 0,
@@ -756,9 +2343,9 @@ class Application
 		};
 
 		auto depth_stencil_state_ci = vk::PipelineDepthStencilStateCreateInfo{
-				.depthTestEnable = VK_TRUE,
-				.depthWriteEnable = VK_TRUE,
-				.depthCompareOp = vk::CompareOp::eLess,
+				.depthTestEnable = desc.depth_test ? VK_TRUE : VK_FALSE,
+				.depthWriteEnable = desc.depth_write ? VK_TRUE : VK_FALSE,
+				.depthCompareOp = desc.depth_compare,
 				.depthBoundsTestEnable = VK_FALSE,
 				.stencilTestEnable = VK_FALSE,
 				.front = vk::StencilOpState{},
@@ -767,13 +2354,14 @@ class Application
 				.maxDepthBounds = 1.0f,
 		};
 
+		// Blending pipelines use straight alpha.
 		auto color_blend_attachment = vk::PipelineColorBlendAttachmentState{
-				.blendEnable = VK_FALSE,
-				.srcColorBlendFactor = vk::BlendFactor::eZero,
-				.dstColorBlendFactor = vk::BlendFactor::eZero,
+				.blendEnable = desc.blend ? VK_TRUE : VK_FALSE,
+				.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
+				.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
 				.colorBlendOp = vk::BlendOp::eAdd,
-				.srcAlphaBlendFactor = vk::BlendFactor::eZero,
-				.dstAlphaBlendFactor = vk::BlendFactor::eZero,
+				.srcAlphaBlendFactor = vk::BlendFactor::eOne,
+				.dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
 				.alphaBlendOp = vk::BlendOp::eAdd,
 				.colorWriteMask = vk::ColorComponentFlagBits::eR |
 						vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB |
@@ -787,21 +2375,19 @@ class Application
 				.blendConstants = array<float, 4>{0, 0, 0, 0},
 		};
 
-		auto pipeline_layout_ci = vk::PipelineLayoutCreateInfo{
-				.setLayoutCount = 1,
-				.pSetLayouts = &_descriptor_set_layout.get(),
-				.pushConstantRangeCount = 0,
-				.pPushConstantRanges = VK_NULL_HANDLE,
-		};
-		_pipeline_layout = check(
-				_device->createPipelineLayoutUnique(pipeline_layout_ci),
-				"Failed to create a pipeline layout.");
-
+		// Libraries ignore the state of the parts they do not hold.
 		auto pipeline_ci = vk::StructureChain<
 				vk::GraphicsPipelineCreateInfo,
-				vk::PipelineRenderingCreateInfoKHR>{
+				vk::PipelineRenderingCreateInfoKHR,
+				vk::GraphicsPipelineLibraryCreateInfoEXT>{
 				vk::GraphicsPipelineCreateInfo{
-						.stageCount = 2,
+						.flags = complete
+								? descriptor_pipeline_flags()
+								: descriptor_pipeline_flags() |
+										vk::PipelineCreateFlagBits::eLibraryKHR |
+										vk::PipelineCreateFlagBits::
+												eRetainLinkTimeOptimizationInfoEXT,
+						.stageCount = stage_count,
 						.pStages = shader_stages.data(),
 						.pVertexInputState = &vertex_input_ci,
 						.pInputAssemblyState = &input_assembly_ci,
@@ -811,7 +2397,7 @@ class Application
 						.pMultisampleState = &multisample_ci,
 						.pDepthStencilState = &depth_stencil_state_ci,
 						.pColorBlendState = &color_blend_ci,
-						.pDynamicState = nullptr,
+						.pDynamicState = &dynamic_state_ci,
 						.layout = _pipeline_layout.get(),
 						.renderPass = VK_NULL_HANDLE,
 						.subpass = 0,
@@ -821,25 +2407,120 @@ class Application
 				vk::PipelineRenderingCreateInfo{
 						.viewMask = 0,
 						.colorAttachmentCount = 1,
-						.pColorAttachmentFormats = &_swapchain_image_format,
-						.depthAttachmentFormat = find_depth_format(),
+						.pColorAttachmentFormats = &desc.color_format,
+						.depthAttachmentFormat = desc.depth_format,
 						.stencilAttachmentFormat = {},
 				},
+				vk::GraphicsPipelineLibraryCreateInfoEXT{
+						.flags = parts,
+				},
 		};
-		_graphics_pipeline = check(
-				_device->createGraphicsPipelineUnique(nullptr, pipeline_ci.get()),
+		if (complete) {
+			pipeline_ci.unlink<vk::GraphicsPipelineLibraryCreateInfoEXT>();
+		}
+		return check(
+				_device->createGraphicsPipelineUnique(
+						_pipeline_cache.get(),
+						pipeline_ci.get()),
 				"Failed to create a graphics pipeline.");
 	}
 
+	auto create_cull_pipeline() -> void
+	{
+		auto shader_code = read_file("shaders/cull.comp.spv");
+		auto shader_module = create_shader_module(shader_code);
+		auto push_constant_range = vk::PushConstantRange{
+				.stageFlags = vk::ShaderStageFlagBits::eCompute,
+				.offset = 0,
+				.size = sizeof(CullConstants),
+		};
+		auto pipeline_layout_ci = vk::PipelineLayoutCreateInfo{
+				.setLayoutCount = 1,
+				.pSetLayouts = &_cull_set_layout.get(),
+				.pushConstantRangeCount = 1,
+				.pPushConstantRanges = &push_constant_range,
+		};
+		_cull_pipeline_layout = check(
+				_device->createPipelineLayoutUnique(pipeline_layout_ci),
+				"Failed to create a pipeline layout.");
+		auto group_size = GroupSize{.x = cull_group_size, .y = 1};
+		auto map_entries = GroupSize::map_entries();
+		auto specialization = vk::SpecializationInfo{
+				.mapEntryCount = map_entries.size(),
+				.pMapEntries = map_entries.data(),
+				.dataSize = sizeof(group_size),
+				.pData = &group_size,
+		};
+		auto pipeline_ci = vk::ComputePipelineCreateInfo{
+				.stage = create_pipeline_shader_info(
+						shader_module.get(),
+						vk::ShaderStageFlagBits::eCompute,
+						specialization),
+				.layout = _cull_pipeline_layout.get(),
+				.basePipelineHandle = VK_NULL_HANDLE,
+				.basePipelineIndex = 0,
+		};
+		_cull_pipeline = check(
+				_device->createComputePipelineUnique(
+						_pipeline_cache.get(),
+						pipeline_ci),
+				"Failed to create a compute pipeline.");
+	}
+
+	auto create_hiz_pipeline() -> void
+	{
+		auto shader_code = read_file("shaders/hiz.comp.spv");
+		auto shader_module = create_shader_module(shader_code);
+		auto push_constant_range = vk::PushConstantRange{
+				.stageFlags = vk::ShaderStageFlagBits::eCompute,
+				.offset = 0,
+				.size = sizeof(HizConstants),
+		};
+		auto pipeline_layout_ci = vk::PipelineLayoutCreateInfo{
+				.setLayoutCount = 1,
+				.pSetLayouts = &_hiz_set_layout.get(),
+				.pushConstantRangeCount = 1,
+				.pPushConstantRanges = &push_constant_range,
+		};
+		_hiz_pipeline_layout = check(
+				_device->createPipelineLayoutUnique(pipeline_layout_ci),
+				"Failed to create a pipeline layout.");
+		auto group_size = GroupSize{.x = hiz_group_size, .y = hiz_group_size};
+		auto map_entries = GroupSize::map_entries();
+		auto specialization = vk::SpecializationInfo{
+				.mapEntryCount = map_entries.size(),
+				.pMapEntries = map_entries.data(),
+				.dataSize = sizeof(group_size),
+				.pData = &group_size,
+		};
+		auto pipeline_ci = vk::ComputePipelineCreateInfo{
+				.stage = create_pipeline_shader_info(
+						shader_module.get(),
+						vk::ShaderStageFlagBits::eCompute,
+						specialization),
+				.layout = _hiz_pipeline_layout.get(),
+				.basePipelineHandle = VK_NULL_HANDLE,
+				.basePipelineIndex = 0,
+		};
+		_hiz_pipeline = check(
+				_device->createComputePipelineUnique(
+						_pipeline_cache.get(),
+						pipeline_ci),
+				"Failed to create a compute pipeline.");
+	}
+
+	// `specialization` has to outlive the pipeline's creation.
 	auto create_pipeline_shader_info(
 			vk::ShaderModule const& module,
-			vk::ShaderStageFlagBits const& stage) -> vk::PipelineShaderStageCreateInfo
+			vk::ShaderStageFlagBits const& stage,
+			vk::SpecializationInfo const& specialization)
+			-> vk::PipelineShaderStageCreateInfo
 	{
 		auto stage_ci = vk::PipelineShaderStageCreateInfo{
 				.stage = stage,
 				.module = module,
 				.pName = "main",
-				.pSpecializationInfo = VK_NULL_HANDLE,
+				.pSpecializationInfo = &specialization,
 		};
 		return stage_ci;
 	}
@@ -866,6 +2547,24 @@ class Application
 		_command_pool = check(
 				_device->createCommandPoolUnique(pool_ci),
 				"Failed to create a command pool.");
+		if (_settings.async_compute) {
+			auto compute_pool_ci = vk::CommandPoolCreateInfo{
+					.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+					.queueFamilyIndex = _queue_familes.compute_family.value(),
+			};
+			_compute_pool = check(
+					_device->createCommandPoolUnique(compute_pool_ci),
+					"Failed to create a command pool.");
+		}
+		// Command pools are externally synchronized, so every recording thread
+		// gets its own, reset as a whole each frame.
+		pool_ci.flags = vk::CommandPoolCreateFlagBits::eTransient;
+		_record_pools.clear();
+		for (auto i = uint32_t{}; i < _settings.record_threads; ++i) {
+			_record_pools.push_back(check(
+					_device->createCommandPoolUnique(pool_ci),
+					"Failed to create a command pool."));
+		}
 	}
 
 	auto create_command_buffers() -> void
@@ -879,17 +2578,91 @@ class Application
 				_device->allocateCommandBuffersUnique(command_buffer_ai),
 				"Failed to allocate command buffers.");
 		_command_buffer = std::move(buffers[0]);
+		_cull_frames.resize(_settings.async_compute ? async_cull_frames : 1);
+		for (auto& frame : _cull_frames) {
+			if (!frame.arena) {
+				frame.arena =
+						std::make_unique<Arena>(frame_arena_size, _settings.huge_pages);
+			}
+		}
+		allocate_prerecorded_buffers();
+		if (_settings.async_compute) {
+			auto compute_ai = vk::CommandBufferAllocateInfo{
+					.commandPool = _compute_pool.get(),
+					.level = vk::CommandBufferLevel::ePrimary,
+					.commandBufferCount = static_cast<uint32_t>(_cull_frames.size()),
+			};
+			auto compute_buffers = check(
+					_device->allocateCommandBuffersUnique(compute_ai),
+					"Failed to allocate command buffers.");
+			for (auto i = size_t{}; i < _cull_frames.size(); ++i) {
+				_cull_frames[i].compute_buffer = std::move(compute_buffers[i]);
+			}
+		}
+		_secondary_buffers.clear();
+		for (auto& pool : _record_pools) {
+			auto secondary_ai = vk::CommandBufferAllocateInfo{
+					.commandPool = pool.get(),
+					.level = vk::CommandBufferLevel::eSecondary,
+					.commandBufferCount = 1,
+			};
+			auto buffers = check(
+					_device->allocateCommandBuffersUnique(secondary_ai),
+					"Failed to allocate command buffers.");
+			_secondary_buffers.push_back(std::move(buffers[0]));
+		}
+	}
+
+	// One command buffer per swapchain image and copy of the culling resources,
+	// recorded again whenever `_commands_dirty` is set.
+	auto allocate_prerecorded_buffers() -> void
+	{
+		if (!_settings.prerecord) {
+			return;
+		}
+		auto count = _swapchain_images.size() * _cull_frames.size();
+		if (_prerecorded_buffers.size() != count) {
+			auto command_buffer_ai = vk::CommandBufferAllocateInfo{
+					.commandPool = _command_pool.get(),
+					.level = vk::CommandBufferLevel::ePrimary,
+					.commandBufferCount = static_cast<uint32_t>(count),
+			};
+			_prerecorded_buffers = check(
+					_device->allocateCommandBuffersUnique(command_buffer_ai),
+					"Failed to allocate command buffers.");
+		}
+		_commands_dirty = true;
 	}
 
+	// The depth image only grows, since rendering to a smaller swapchain can
+	// use its corner. The Hi-Z pyramid is built from the whole image, though,
+	// so with occlusion culling it has to match the swapchain exactly.
 	auto create_depth_resources() -> void
 	{
+		auto fits = _settings.occlusion_culling
+				? _depth_extent == _swapchain_extent
+				: _depth_extent.width >= _swapchain_extent.width &&
+						_depth_extent.height >= _swapchain_extent.height;
+		if (_depth_image.image && fits) {
+			return;
+		}
+		_depth_extent = vk::Extent2D{
+				.width = std::max(_swapchain_extent.width, _depth_extent.width),
+				.height = std::max(_swapchain_extent.height, _depth_extent.height),
+		};
+		if (_settings.occlusion_culling) {
+			_depth_extent = _swapchain_extent;
+		}
 		auto depth_format = find_depth_format();
 		_depth_image = create_image(
-				_swapchain_extent.width,
-				_swapchain_extent.height,
+				_depth_extent.width,
+				_depth_extent.height,
 				depth_format,
 				vk::ImageTiling::eOptimal,
-				vk::ImageUsageFlagBits::eDepthStencilAttachment,
+				_settings.occlusion_culling
+						? vk::ImageUsageFlagBits::eDepthStencilAttachment |
+								vk::ImageUsageFlagBits::eSampled
+						: vk::ImageUsageFlagBits::eDepthStencilAttachment,
 				vk::MemoryPropertyFlagBits::eDeviceLocal);
 		auto view_ci = vk::ImageViewCreateInfo{
 				.image = _depth_image.image.get(),
@@ -908,93 +2681,238 @@ class Application
 		_depth_image_view = check(_device->createImageViewUnique(view_ci));
 	}
 
-	auto find_depth_format() -> vk::Format
+	// Builds the depth pyramid sampled by the late culling pass. Level 0
+	// matches the depth image and every further level halves it, rounding down.
+	// Without occlusion culling the cull shader still declares the pyramid but
+	// never reads it, so a single texel stands in to keep its descriptor valid.
+	auto create_hiz_resources() -> void
 	{
-		static auto format = optional<vk::Format>{};
-		if (format.has_value()) {
-			return format.value();
+		if (_settings.culling != CullingMode::gpu) {
+			return;
 		}
-		auto formats = array<vk::Format, 2>{
-				vk::Format::eD32Sfloat,
-				vk::Format::eD16Unorm,
-		};
-		format = find_supported_format(
-				formats,
+		auto extent = _settings.occlusion_culling
+				? _swapchain_extent
+				: vk::Extent2D{.width = 1, .height = 1};
+		auto levels = static_cast<uint32_t>(
+				std::bit_width(std::max(extent.width, extent.height)));
+		_hiz_image = create_image(
+				extent.width,
+				extent.height,
+				vk::Format::eR32Sfloat,
 				vk::ImageTiling::eOptimal,
-				vk::FormatFeatureFlagBits::eDepthStencilAttachment);
-		return format.value();
+				vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
+				vk::MemoryPropertyFlagBits::eDeviceLocal,
+				levels);
+		auto view_ci = vk::ImageViewCreateInfo{
+				.image = _hiz_image.image.get(),
+				.viewType = vk::ImageViewType::e2D,
+				.format = vk::Format::eR32Sfloat,
+				.components = vk::ComponentMapping{},
+				.subresourceRange =
+						vk::ImageSubresourceRange{
+								.aspectMask = vk::ImageAspectFlagBits::eColor,
+								.baseMipLevel = 0,
+								.levelCount = levels,
+								.baseArrayLayer = 0,
+								.layerCount = 1,
+						},
+		};
+		_hiz_image_view = check(_device->createImageViewUnique(view_ci));
+		_hiz_level_views.resize(levels);
+		for (auto level = uint32_t{}; level < levels; ++level) {
+			view_ci.subresourceRange.baseMipLevel = level;
+			view_ci.subresourceRange.levelCount = 1;
+			_hiz_level_views[level] = check(_device->createImageViewUnique(view_ci));
+		}
+		auto sampler_ci = vk::SamplerCreateInfo{
+				.magFilter = vk::Filter::eNearest,
+				.minFilter = vk::Filter::eNearest,
+				.mipmapMode = vk::SamplerMipmapMode::eNearest,
+				.addressModeU = vk::SamplerAddressMode::eClampToEdge,
+				.addressModeV = vk::SamplerAddressMode::eClampToEdge,
+				.addressModeW = vk::SamplerAddressMode::eClampToEdge,
+				.mipLodBias = 0.0f,
+				.anisotropyEnable = VK_FALSE,
+				.maxAnisotropy = 1.0f,
+				.compareEnable = VK_FALSE,
+				.compareOp = vk::CompareOp::eAlways,
+				.minLod = 0.0f,
+				.maxLod = VK_LOD_CLAMP_NONE,
+				.borderColor = vk::BorderColor::eFloatOpaqueWhite,
+				.unnormalizedCoordinates = VK_FALSE,
+		};
+		if (!_hiz_sampler) {
+			_hiz_sampler = check(
+					_device->createSamplerUnique(sampler_ci),
+					"Failed to create a Hi-Z sampler.");
+		}
+		if (_settings.occlusion_culling) {
+			create_hiz_descriptor_sets();
+		}
 	}
 
-	auto find_supported_format(
-			span<vk::Format> candidates,
-			vk::ImageTiling tiling,
-			vk::FormatFeatureFlags features) -> vk::Format
+	// One set per pyramid level, reading the level above (or the depth image)
+	// and writing the level itself.
+	auto create_hiz_descriptor_sets() -> void
 	{
-		for (auto format : candidates) {
-			auto properties = _physical_device.getFormatProperties(format);
-			if (tiling == vk::ImageTiling::eLinear &&
-					(properties.linearTilingFeatures & features)) {
-				return format;
-			}
-			if (tiling == vk::ImageTiling::eOptimal &&
-					(properties.optimalTilingFeatures & features)) {
-				return format;
-			}
-		}
-		fail("Failed to find a suitable format.");
+		auto levels = static_cast<uint32_t>(_hiz_level_views.size());
+		auto pool_sizes = array<vk::DescriptorPoolSize, 2>{
+				vk::DescriptorPoolSize{
+						.type = vk::DescriptorType::eCombinedImageSampler,
+						.descriptorCount = levels,
+				},
+				vk::DescriptorPoolSize{
+						.type = vk::DescriptorType::eStorageImage,
+						.descriptorCount = levels,
+				},
+		};
+		auto pool_ci = vk::DescriptorPoolCreateInfo{
+				.maxSets = levels,
+				.poolSizeCount = pool_sizes.size(),
+				.pPoolSizes = pool_sizes.data(),
+		};
+		_hiz_descriptor_pool = check(
+				_device->createDescriptorPoolUnique(pool_ci),
+				"Failed to create a descriptor pool.");
+		auto layouts = vector<vk::DescriptorSetLayout>(levels, _hiz_set_layout.get());
+		auto alloc_info = vk::DescriptorSetAllocateInfo{
+				.descriptorPool = _hiz_descriptor_pool.get(),
+				.descriptorSetCount = levels,
+				.pSetLayouts = layouts.data(),
+		};
+		_hiz_descriptor_sets = check(
+				_device->allocateDescriptorSets(alloc_info),
+				"Failed to allocate descriptor sets.");
+		for (auto level = uint32_t{}; level < levels; ++level) {
+			auto source_info = vk::DescriptorImageInfo{
+					.sampler = _hiz_sampler.get(),
+					.imageView = level == 0 ? _depth_image_view.get()
+																	: _hiz_level_views[level - 1].get(),
+					.imageLayout = level == 0 ? vk::ImageLayout::eShaderReadOnlyOptimal
+																		: vk::ImageLayout::eGeneral,
+			};
+			auto destination_info = vk::DescriptorImageInfo{
+					.sampler = VK_NULL_HANDLE,
+					.imageView = _hiz_level_views[level].get(),
+					.imageLayout = vk::ImageLayout::eGeneral,
+			};
+			auto descriptor_writes = array<vk::WriteDescriptorSet, 2>{
+					vk::WriteDescriptorSet{
+							.dstSet = _hiz_descriptor_sets[level],
+							.dstBinding = 0,
+							.dstArrayElement = 0,
+							.descriptorCount = 1,
+							.descriptorType = vk::DescriptorType::eCombinedImageSampler,
+							.pImageInfo = &source_info,
+							.pBufferInfo = VK_NULL_HANDLE,
+							.pTexelBufferView = VK_NULL_HANDLE,
+					},
+					vk::WriteDescriptorSet{
+							.dstSet = _hiz_descriptor_sets[level],
+							.dstBinding = 1,
+							.dstArrayElement = 0,
+							.descriptorCount = 1,
+							.descriptorType = vk::DescriptorType::eStorageImage,
+							.pImageInfo = &destination_info,
+							.pBufferInfo = VK_NULL_HANDLE,
+							.pTexelBufferView = VK_NULL_HANDLE,
+					},
+			};
+			_device->updateDescriptorSets(descriptor_writes, VK_NULL_HANDLE);
+		}
+	}
+
+	auto find_depth_format() -> vk::Format
+	{
+		static auto format = optional<vk::Format>{};
+		if (format.has_value()) {
+			return format.value();
+		}
+		auto formats = array<vk::Format, 2>{
+				vk::Format::eD32Sfloat,
+				vk::Format::eD16Unorm,
+		};
+		format = find_supported_format(
+				formats,
+				vk::ImageTiling::eOptimal,
+				vk::FormatFeatureFlagBits::eDepthStencilAttachment |
+						vk::FormatFeatureFlagBits::eSampledImage);
+		return format.value();
+	}
+
+	auto find_supported_format(
+			span<vk::Format> candidates,
+			vk::ImageTiling tiling,
+			vk::FormatFeatureFlags features) -> vk::Format
+	{
+		for (auto format : candidates) {
+			auto properties = _physical_device.getFormatProperties(format);
+			if (tiling == vk::ImageTiling::eLinear &&
+					(properties.linearTilingFeatures & features) == features) {
+				return format;
+			}
+			if (tiling == vk::ImageTiling::eOptimal &&
+					(properties.optimalTilingFeatures & features) == features) {
+				return format;
+			}
+		}
+		fail("Failed to find a suitable format.");
 		return vk::Format{};
 	}
 
-	auto create_texture_image() -> void
+	auto load_texture(char const* file_name) -> Task<DecodedImage>
 	{
+		auto bytes = co_await read_file_async(_jobs, file_name);
 		auto width = 0;
 		auto height = 0;
 		auto num_components = 0;
-		auto* pixels = stbi_load(
-				texture_path,
+		auto image = DecodedImage{};
+		image.pixels.reset(stbi_load_from_memory(
+				reinterpret_cast<stbi_uc const*>(bytes.data()),
+				static_cast<int>(bytes.size()),
 				&width,
 				&height,
 				&num_components,
-				STBI_rgb_alpha);
-		if (pixels == nullptr) {
+				STBI_rgb_alpha));
+		if (image.pixels == nullptr) {
 			fail("Failed to read texture.");
 		}
-		auto size = width * height * STBI_rgb_alpha;
-		auto stage = create_buffer(
-				size,
-				vk::BufferUsageFlagBits::eTransferSrc,
-				vk::MemoryPropertyFlagBits::eHostVisible |
-						vk::MemoryPropertyFlagBits::eHostCoherent);
-		void* data = nullptr;
-		check(_device->mapMemory(
-				stage.memory.get(),
-				0,
-				size,
-				vk::MemoryMapFlags{},
-				&data));
-		memcpy(data, pixels, size);
-		_device->unmapMemory(stage.memory.get());
-		stbi_image_free(pixels);
-		_texture_image = create_image(
-				width,
-				height,
+		image.width = static_cast<uint32_t>(width);
+		image.height = static_cast<uint32_t>(height);
+		co_return image;
+	}
+
+	auto upload_texture(DecodedImage const& texture) -> Task<ImageMemory>
+	{
+		co_await resume_on(_jobs);
+		auto size = vk::DeviceSize{texture.width} * texture.height * STBI_rgb_alpha;
+		auto stage = create_staging_buffer(texture.pixels.get(), size);
+		auto image = create_image(
+				texture.width,
+				texture.height,
 				vk::Format::eR8G8B8A8Srgb,
 				vk::ImageTiling::eOptimal,
 				vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
 				vk::MemoryPropertyFlagBits::eDeviceLocal);
-		transition_image_layout(
-				_texture_image.image.get(),
-				vk::ImageLayout::eUndefined,
-				vk::ImageLayout::eTransferDstOptimal);
-		copy_buffer_to_image(
-				stage.buffer.get(),
-				_texture_image.image.get(),
-				width,
-				height);
-		transition_image_layout(
-				_texture_image.image.get(),
-				vk::ImageLayout::eTransferDstOptimal,
-				vk::ImageLayout::eShaderReadOnlyOptimal);
+		co_await submit_upload([&](vk::CommandBuffer commands) {
+			transition_image_layout(
+					commands,
+					image.image.get(),
+					vk::ImageLayout::eUndefined,
+					vk::ImageLayout::eTransferDstOptimal);
+			copy_buffer_to_image(
+					commands,
+					stage.buffer.get(),
+					image.image.get(),
+					texture.width,
+					texture.height);
+			transition_image_layout(
+					commands,
+					image.image.get(),
+					vk::ImageLayout::eTransferDstOptimal,
+					vk::ImageLayout::eShaderReadOnlyOptimal);
+		});
+		co_return image;
 	}
 
 	auto create_image(
@@ -1003,7 +2921,8 @@ class Application
 			vk::Format format,
 			vk::ImageTiling tiling,
 			vk::ImageUsageFlags usage,
-			vk::MemoryPropertyFlags properties) -> ImageMemory
+			vk::MemoryPropertyFlags properties,
+			uint32_t mip_levels = 1) -> ImageMemory
 	{
 		auto image_memory = ImageMemory{};
 		auto image_ci = vk::ImageCreateInfo{
@@ -1015,7 +2934,7 @@ class Application
 								.height = height,
 								.depth = 1,
 						},
-				.mipLevels = 1,
+				.mipLevels = mip_levels,
 				.arrayLayers = 1,
 				.samples = vk::SampleCountFlagBits::e1,
 				.tiling = tiling,
@@ -1045,6 +2964,7 @@ class Application
 	}
 
 	auto transition_image_layout(
+			vk::CommandBuffer commands,
 			vk::Image image,
 			vk::ImageLayout old_layout,
 			vk::ImageLayout new_layout) -> void
@@ -1085,12 +3005,7 @@ class Application
 								.layerCount = 1,
 						},
 		};
-		auto cmd_begin_info = vk::CommandBufferBeginInfo{
-				.pInheritanceInfo = VK_NULL_HANDLE,
-		};
-		_command_buffer->reset();
-		check(_command_buffer->begin(cmd_begin_info));
-		_command_buffer->pipelineBarrier(
+		commands.pipelineBarrier(
 				src_stage,
 				dst_stage,
 				vk::DependencyFlagBits{},
@@ -1100,23 +3015,10 @@ class Application
 				nullptr,
 				1,
 				&barrier);
-		check(_command_buffer->end());
-		auto submit_info = vk::SubmitInfo{
-				.waitSemaphoreCount = 0,
-				.pWaitSemaphores = VK_NULL_HANDLE,
-				.pWaitDstStageMask = VK_NULL_HANDLE,
-				.commandBufferCount = 1,
-				.pCommandBuffers = &_command_buffer.get(),
-				.signalSemaphoreCount = 0,
-				.pSignalSemaphores = VK_NULL_HANDLE,
-		};
-		check(
-				_graphics_queue.submit(1, &submit_info, VK_NULL_HANDLE),
-				"Failed to submit a command buffer.");
-		check(_graphics_queue.waitIdle());
 	}
 
 	auto copy_buffer_to_image(
+			vk::CommandBuffer commands,
 			vk::Buffer buffer,
 			vk::Image image,
 			uint32_t width,
@@ -1145,31 +3047,12 @@ class Application
 								.depth = 1,
 						},
 		};
-		auto cmd_begin_info = vk::CommandBufferBeginInfo{
-				.pInheritanceInfo = VK_NULL_HANDLE,
-		};
-		_command_buffer->reset();
-		check(_command_buffer->begin(cmd_begin_info));
-		_command_buffer->copyBufferToImage(
+		commands.copyBufferToImage(
 				buffer,
 				image,
 				vk::ImageLayout::eTransferDstOptimal,
 				1,
 				&spec);
-		check(_command_buffer->end());
-		auto submit_info = vk::SubmitInfo{
-				.waitSemaphoreCount = 0,
-				.pWaitSemaphores = VK_NULL_HANDLE,
-				.pWaitDstStageMask = VK_NULL_HANDLE,
-				.commandBufferCount = 1,
-				.pCommandBuffers = &_command_buffer.get(),
-				.signalSemaphoreCount = 0,
-				.pSignalSemaphores = VK_NULL_HANDLE,
-		};
-		check(
-				_graphics_queue.submit(1, &submit_info, VK_NULL_HANDLE),
-				"Failed to submit a command buffer.");
-		check(_graphics_queue.waitIdle());
 	}
 
 	auto create_texture_image_view() -> void
@@ -1193,7 +3076,7 @@ class Application
 
 	auto create_texture_sampler() -> void
 	{
-		auto properties = _physical_device.getProperties();
+		auto const& properties = _device_info.properties;
 		auto sampler_ci = vk::SamplerCreateInfo{
 				.magFilter = vk::Filter::eLinear,
 				.minFilter = vk::Filter::eLinear,
@@ -1216,8 +3099,9 @@ class Application
 				"Failed to create a texture sampler.");
 	}
 
-	auto load_model() -> void
+	auto load_model() -> Task<>
 	{
+		co_await resume_on(_jobs);
 		auto config = tinyobj::ObjReaderConfig{};
 		config.mtl_search_path = "./";
 		auto reader = tinyobj::ObjReader{};
@@ -1248,11 +3132,128 @@ class Application
 				_indices.push_back(_indices.size());
 			}
 		}
+		_mesh_lower = _vertices[0].position;
+		_mesh_upper = _vertices[0].position;
+		for (auto const& vertex : _vertices) {
+			_mesh_lower = glm::min(_mesh_lower, vertex.position);
+			_mesh_upper = glm::max(_mesh_upper, vertex.position);
+		}
+		auto center = (_mesh_lower + _mesh_upper) * 0.5f;
+		auto radius = 0.0f;
+		for (auto const& vertex : _vertices) {
+			radius = std::max(radius, glm::distance(center, vertex.position));
+		}
+		_mesh_bounds = glm::vec4{center, radius};
+	}
+
+	// Lays the requested number of model copies out on a square grid in the
+	// model's XY plane, centered on the origin.
+	auto create_objects() -> void
+	{
+		auto side = static_cast<uint32_t>(
+				ceil(std::sqrt(static_cast<float>(_settings.object_count))));
+		auto spacing = 2.0f * _mesh_bounds.w;
+		auto origin = -0.5f * spacing * static_cast<float>(side - 1);
+		auto texture =
+				add_texture(_texture_image_view.get(), _texture_sampler.get());
+		_objects.resize(_settings.object_count);
+		_bounds.reserve(_settings.object_count);
+		for (auto i = uint32_t{}; i < _settings.object_count; ++i) {
+			auto offset = glm::vec3{
+					origin + spacing * static_cast<float>(i % side),
+					origin + spacing * static_cast<float>(i / side),
+					0.0f};
+			_objects[i] = ObjectData{
+					.offset = offset,
+					.texture_index = texture,
+					.bounds = glm::vec4{glm::vec3{_mesh_bounds} + offset, _mesh_bounds.w},
+			};
+			_bounds.push_back(
+					_objects[i].bounds,
+					_mesh_lower + offset,
+					_mesh_upper + offset);
+		}
+		_visible.resize(_bounds.padded_size());
+		std::iota(_visible.begin(), _visible.begin() + _objects.size(), 0);
+		_visible_count = _objects.size();
+	}
+
+	auto create_object_buffers() -> void
+	{
+		_object_buffer = create_device_local_buffer(
+				_objects.data(),
+				sizeof(ObjectData) * _objects.size(),
+				vk::BufferUsageFlagBits::eStorageBuffer | descriptor_buffer_flags());
+		_object_buffer_index = add_buffer(
+				_object_buffer.buffer.get(),
+				sizeof(ObjectData) * _objects.size());
+		// Draws culled on the CPU are written straight into host-visible memory.
+		auto cpu_culling = _settings.culling == CullingMode::cpu;
+		auto draw_memory = cpu_culling
+				? vk::MemoryPropertyFlagBits::eHostVisible |
+						vk::MemoryPropertyFlagBits::eHostCoherent
+				: vk::MemoryPropertyFlags{vk::MemoryPropertyFlagBits::eDeviceLocal};
+		// Occlusion culling keeps separate draw lists for its early and late
+		// passes, back to back.
+		auto lists = _settings.occlusion_culling ? size_t{2} : size_t{1};
+		auto draw_size =
+				sizeof(vk::DrawIndexedIndirectCommand) * _objects.size() * lists;
+		auto visibility = vector<uint32_t>{};
+		if (_settings.culling == CullingMode::gpu) {
+			visibility.resize(_objects.size(), 0);
+		}
+		for (auto& frame : _cull_frames) {
+			frame.draw_buffer = create_buffer(
+					draw_size,
+					vk::BufferUsageFlagBits::eStorageBuffer |
+							vk::BufferUsageFlagBits::eIndirectBuffer,
+					draw_memory);
+			frame.draw_count_buffer = create_buffer(
+					sizeof(uint32_t) * lists,
+					vk::BufferUsageFlagBits::eStorageBuffer |
+							vk::BufferUsageFlagBits::eIndirectBuffer |
+							vk::BufferUsageFlagBits::eTransferDst,
+					draw_memory);
+			if (cpu_culling) {
+				check(_device->mapMemory(
+						frame.draw_buffer.memory.get(),
+						0,
+						draw_size,
+						vk::MemoryMapFlags{},
+						&frame.draw_data));
+				check(_device->mapMemory(
+						frame.draw_count_buffer.memory.get(),
+						0,
+						sizeof(uint32_t),
+						vk::MemoryMapFlags{},
+						&frame.draw_count_data));
+			}
+			if (_settings.culling != CullingMode::gpu) {
+				continue;
+			}
+			frame.visibility_buffer = create_device_local_buffer(
+					visibility.data(),
+					sizeof(uint32_t) * visibility.size(),
+					vk::BufferUsageFlagBits::eStorageBuffer);
+			frame.statistics_buffer = create_buffer(
+					sizeof(uint32_t),
+					vk::BufferUsageFlagBits::eStorageBuffer |
+							vk::BufferUsageFlagBits::eTransferDst,
+					vk::MemoryPropertyFlagBits::eHostVisible |
+							vk::MemoryPropertyFlagBits::eHostCoherent);
+			check(_device->mapMemory(
+					frame.statistics_buffer.memory.get(),
+					0,
+					sizeof(uint32_t),
+					vk::MemoryMapFlags{},
+					&frame.statistics_data));
+			memset(frame.statistics_data, 0, sizeof(uint32_t));
+		}
 	}
 
-	auto create_vertex_buffer() -> void
+	auto create_staging_buffer(void const* contents, vk::DeviceSize size)
+			-> BufferMemory
 	{
-		auto size = sizeof(Vertex) * _vertices.size();
 		auto stage = create_buffer(
 				size,
 				vk::BufferUsageFlagBits::eTransferSrc,
@@ -1265,39 +3266,183 @@ class Application
 				size,
 				vk::MemoryMapFlags{},
 				&data));
-		memcpy(data, _vertices.data(), size);
+		memcpy(data, contents, size);
 		_device->unmapMemory(stage.memory.get());
-		_vertex_buffer = create_buffer(
+		return stage;
+	}
+
+	auto create_device_local_buffer(
+			void const* contents,
+			vk::DeviceSize size,
+			vk::BufferUsageFlags flags) -> BufferMemory
+	{
+		auto stage = create_staging_buffer(contents, size);
+		auto buffer = create_buffer(
 				size,
-				vk::BufferUsageFlagBits::eVertexBuffer |
-						vk::BufferUsageFlagBits::eTransferDst,
+				flags | vk::BufferUsageFlagBits::eTransferDst,
 				vk::MemoryPropertyFlagBits::eDeviceLocal);
-		copy_buffer(stage.buffer.get(), _vertex_buffer.buffer.get(), size);
+		copy_buffer(std::move(stage), buffer.buffer.get(), size);
+		return buffer;
 	}
 
-	auto create_index_buffer() -> void
+	// Asynchronous counterpart of create_device_local_buffer. `contents` only
+	// has to stay valid until the upload is awaited.
+	auto upload(
+			void const* contents,
+			vk::DeviceSize size,
+			vk::BufferUsageFlags flags) -> Task<BufferMemory>
 	{
-		auto size = sizeof(_indices[0]) * _indices.size();
-		auto stage = create_buffer(
-				size,
-				vk::BufferUsageFlagBits::eTransferSrc,
-				vk::MemoryPropertyFlagBits::eHostVisible |
-						vk::MemoryPropertyFlagBits::eHostCoherent);
-		void* data = nullptr;
-		check(_device->mapMemory(
-				stage.memory.get(),
-				0,
+		co_await resume_on(_jobs);
+		auto stage = create_staging_buffer(contents, size);
+		auto buffer = create_buffer(
 				size,
-				vk::MemoryMapFlags{},
-				&data));
-		memcpy(data, _indices.data(), size);
-		_device->unmapMemory(stage.memory.get());
-		_index_buffer = create_buffer(
-				size,
-				vk::BufferUsageFlagBits::eIndexBuffer |
-						vk::BufferUsageFlagBits::eTransferDst,
+				flags | vk::BufferUsageFlagBits::eTransferDst,
 				vk::MemoryPropertyFlagBits::eDeviceLocal);
-		copy_buffer(stage.buffer.get(), _index_buffer.buffer.get(), size);
+		co_await submit_upload([&](vk::CommandBuffer commands) {
+			auto copy = vk::BufferCopy{
+					.srcOffset = 0,
+					.dstOffset = 0,
+					.size = size,
+			};
+			commands.copyBuffer(stage.buffer.get(), buffer.buffer.get(), 1, &copy);
+		});
+		co_return buffer;
+	}
+
+	// Records commands into a command buffer of their own, submits them and
+	// suspends until the GPU has executed them, resuming on a job thread.
+	template <typename Record>
+	auto submit_upload(Record record) -> Task<>
+	{
+		auto pool_ci = vk::CommandPoolCreateInfo{
+				.flags = vk::CommandPoolCreateFlagBits::eTransient,
+				.queueFamilyIndex = _queue_familes.graphics_family.value(),
+		};
+		auto pool = check(
+				_device->createCommandPoolUnique(pool_ci),
+				"Failed to create a command pool.");
+		auto buffer_ai = vk::CommandBufferAllocateInfo{
+				.commandPool = pool.get(),
+				.level = vk::CommandBufferLevel::ePrimary,
+				.commandBufferCount = 1,
+		};
+		auto buffers = check(
+				_device->allocateCommandBuffersUnique(buffer_ai),
+				"Failed to allocate command buffers.");
+		auto begin_info = vk::CommandBufferBeginInfo{
+				.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+				.pInheritanceInfo = VK_NULL_HANDLE,
+		};
+		check(buffers[0]->begin(begin_info));
+		record(buffers[0].get());
+		check(buffers[0]->end());
+		auto value = uint64_t{};
+		{
+			auto lock = std::scoped_lock{_queue_mutex};
+			value = ++_graphics_timeline.reserved;
+			auto timeline_si = vk::TimelineSemaphoreSubmitInfo{
+					.waitSemaphoreValueCount = 0,
+					.pWaitSemaphoreValues = VK_NULL_HANDLE,
+					.signalSemaphoreValueCount = 1,
+					.pSignalSemaphoreValues = &value,
+			};
+			auto submit_info = vk::SubmitInfo{
+					.pNext = &timeline_si,
+					.waitSemaphoreCount = 0,
+					.pWaitSemaphores = VK_NULL_HANDLE,
+					.pWaitDstStageMask = VK_NULL_HANDLE,
+					.commandBufferCount = 1,
+					.pCommandBuffers = &buffers[0].get(),
+					.signalSemaphoreCount = 1,
+					.pSignalSemaphores = &_graphics_timeline.semaphore.get(),
+			};
+			check(
+					_graphics_queue.submit(1, &submit_info, VK_NULL_HANDLE),
+					"Failed to submit an upload.");
+		}
+		co_await _upload_waiters.wait(value);
+	}
+
+	auto create_timelines() -> void
+	{
+		auto timeline_ci = vk::StructureChain{
+				vk::SemaphoreCreateInfo{},
+				vk::SemaphoreTypeCreateInfo{
+						.semaphoreType = vk::SemaphoreType::eTimeline,
+						.initialValue = 0,
+				},
+		};
+		_graphics_timeline.semaphore = check(
+				_device->createSemaphoreUnique(timeline_ci.get()),
+				"Failed to create a semaphore.");
+		if (_settings.async_compute) {
+			_compute_timeline.semaphore = check(
+					_device->createSemaphoreUnique(timeline_ci.get()),
+					"Failed to create a semaphore.");
+		}
+	}
+
+	// Picks up the timeline value of the frame last handed to submit_frame,
+	// waiting for the submit thread to submit it if need be.
+	auto sync_frame_value() -> void
+	{
+		if (!_frame_pending) {
+			return;
+		}
+		_frame_pending = false;
+		auto value = _submitted_value.load(std::memory_order_acquire);
+		while (value == _frame_value) {
+			_submitted_value.wait(value, std::memory_order_acquire);
+			value = _submitted_value.load(std::memory_order_acquire);
+		}
+		_frame_value = value;
+		_cull_frames[_last_cull_frame].frame_value = value;
+		for (auto& resources : _retired) {
+			if (resources.value == next_frame_value) {
+				resources.value = value;
+			}
+		}
+		if (_settings.present_wait) {
+			_present_id = value;
+			_present_acquire_time = _acquire_time;
+		}
+	}
+
+	// Blocks until the latest frame has finished on the GPU.
+	auto wait_for_frame() -> void
+	{
+		sync_frame_value();
+		wait_for_graphics(_frame_value);
+	}
+
+	// Blocks until the graphics queue has finished the submission that signals
+	// `value`, which need not have been submitted yet.
+	auto wait_for_graphics(uint64_t value) -> void
+	{
+		auto wait_info = vk::SemaphoreWaitInfo{
+				.semaphoreCount = 1,
+				.pSemaphores = &_graphics_timeline.semaphore.get(),
+				.pValues = &value,
+		};
+		check(
+				_device->waitSemaphores(wait_info, UINT64_MAX),
+				"Failed to wait for the graphics queue.");
+	}
+
+	// Destroys whatever was retired with a value the timeline has reached.
+	auto destroy_retired(uint64_t completed) -> void
+	{
+		std::erase_if(_retired, [completed](RetiredResources const& resources) {
+			return resources.value <= completed;
+		});
+	}
+
+	// Resumes the uploads whose copies the GPU has finished.
+	auto poll_uploads() -> void
+	{
+		auto value = check(_device->getSemaphoreCounterValue(
+				_graphics_timeline.semaphore.get()));
+		_upload_waiters.resume_reached(value, _jobs);
 	}
 
 	auto create_uniform_buffer() -> void
@@ -1305,7 +3450,7 @@ class Application
 		auto size = sizeof(UniformBufferObject);
 		_uniform_buffer = create_buffer(
 				size,
-				vk::BufferUsageFlagBits::eUniformBuffer,
+				vk::BufferUsageFlagBits::eUniformBuffer | descriptor_buffer_flags(),
 				vk::MemoryPropertyFlagBits::eHostVisible |
 						vk::MemoryPropertyFlagBits::eHostCoherent);
 		check(_device->mapMemory(
@@ -1314,6 +3459,24 @@ class Application
 				size,
 				vk::MemoryMapFlags{},
 				&_uniform_data));
+		// Culling ahead of the frame being drawn must not overwrite the uniforms
+		// it reads, so every copy of the culling resources has its own.
+		if (_settings.culling != CullingMode::gpu) {
+			return;
+		}
+		for (auto& frame : _cull_frames) {
+			frame.uniform_buffer = create_buffer(
+					size,
+					vk::BufferUsageFlagBits::eUniformBuffer,
+					vk::MemoryPropertyFlagBits::eHostVisible |
+							vk::MemoryPropertyFlagBits::eHostCoherent);
+			check(_device->mapMemory(
+					frame.uniform_buffer.memory.get(),
+					0,
+					size,
+					vk::MemoryMapFlags{},
+					&frame.uniform_data));
+		}
 	};
 
 	auto create_buffer(
@@ -1322,25 +3485,47 @@ class Application
 			vk::MemoryPropertyFlags properties) -> BufferMemory
 	{
 		auto buffer_memory = BufferMemory{};
+		// Buffers that culling may touch are shared with the compute queue rather
+		// than transferred between the queues every frame.
+		auto shared = _settings.async_compute &&
+				(flags &
+				 (vk::BufferUsageFlagBits::eUniformBuffer |
+					vk::BufferUsageFlagBits::eStorageBuffer |
+					vk::BufferUsageFlagBits::eIndirectBuffer));
+		auto families = array<uint32_t, 2>{
+				_queue_familes.graphics_family.value(),
+				_queue_familes.compute_family.value_or(0)};
 		auto buffer_ci = vk::BufferCreateInfo{
 				.size = size,
 				.usage = flags,
-				.sharingMode = vk::SharingMode::eExclusive,
-				.queueFamilyIndexCount = 0,
-				.pQueueFamilyIndices = VK_NULL_HANDLE,
+				.sharingMode =
+						shared ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive,
+				.queueFamilyIndexCount = shared ? uint32_t{2} : uint32_t{0},
+				.pQueueFamilyIndices = shared ? families.data() : VK_NULL_HANDLE,
 		};
 		buffer_memory.buffer = check(
 				_device->createBufferUnique(buffer_ci),
 				"Failed to create a buffer.");
 		auto memory_requirements =
 				_device->getBufferMemoryRequirements(buffer_memory.buffer.get());
-		auto allocate_info = vk::MemoryAllocateInfo{
-				.allocationSize = memory_requirements.size,
-				.memoryTypeIndex =
-						find_memory_type(memory_requirements.memoryTypeBits, properties),
+		auto allocate_info = vk::StructureChain<
+				vk::MemoryAllocateInfo,
+				vk::MemoryAllocateFlagsInfo>{
+				vk::MemoryAllocateInfo{
+						.allocationSize = memory_requirements.size,
+						.memoryTypeIndex = find_memory_type(
+								memory_requirements.memoryTypeBits,
+								properties),
+				},
+				vk::MemoryAllocateFlagsInfo{
+						.flags = vk::MemoryAllocateFlagBits::eDeviceAddress,
+				},
 		};
+		if (!(flags & vk::BufferUsageFlagBits::eShaderDeviceAddress)) {
+			allocate_info.unlink<vk::MemoryAllocateFlagsInfo>();
+		}
 		buffer_memory.memory = check(
-				_device->allocateMemoryUnique(allocate_info),
+				_device->allocateMemoryUnique(allocate_info.get()),
 				"Failed to allocate buffer memory.");
 		check(_device->bindBufferMemory(
 				buffer_memory.buffer.get(),
@@ -1353,7 +3538,7 @@ class Application
 			uint32_t type_filter,
 			vk::MemoryPropertyFlags const& properties) -> uint32_t
 	{
-		auto memory_properties = _physical_device.getMemoryProperties();
+		auto const& memory_properties = _device_info.memory_properties;
 		for (auto i = uint32_t{0}; i < memory_properties.memoryTypeCount; i++) {
 			if (((type_filter & (1 << i)) != 0u) &&
 					(memory_properties.memoryTypes[i].propertyFlags & properties) ==
@@ -1365,52 +3550,87 @@ class Application
 		return 0;  // unreachable
 	}
 
+	// Copies without waiting for the copy to finish. The staging buffer is
+	// retired until it has, and every frame waits for all earlier submissions.
 	auto copy_buffer(
-			vk::Buffer const& src,
+			BufferMemory stage,
 			vk::Buffer const& dst,
 			vk::DeviceSize size) -> void
 	{
+		auto buffer_ai = vk::CommandBufferAllocateInfo{
+				.commandPool = _command_pool.get(),
+				.level = vk::CommandBufferLevel::ePrimary,
+				.commandBufferCount = 1,
+		};
+		auto buffers = check(
+				_device->allocateCommandBuffersUnique(buffer_ai),
+				"Failed to allocate command buffers.");
 		auto begin_info = vk::CommandBufferBeginInfo{
+				.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
 				.pInheritanceInfo = VK_NULL_HANDLE,
 		};
-		check(_command_buffer->reset());
-		check(_command_buffer->begin(begin_info));
+		check(buffers[0]->begin(begin_info));
 		auto copy = vk::BufferCopy{
 				.srcOffset = 0,
 				.dstOffset = 0,
 				.size = size,
 		};
-		_command_buffer->copyBuffer(src, dst, 1, &copy);
-		check(_command_buffer->end());
-		auto submit_info = vk::SubmitInfo{
-				.waitSemaphoreCount = 0,
-				.pWaitSemaphores = VK_NULL_HANDLE,
-				.pWaitDstStageMask = VK_NULL_HANDLE,
-				.commandBufferCount = 1,
-				.pCommandBuffers = &_command_buffer.get(),
-				.signalSemaphoreCount = 0,
-				.pSignalSemaphores = VK_NULL_HANDLE,
-		};
-		check(
-				_graphics_queue.submit(1, &submit_info, VK_NULL_HANDLE),
-				"Failed to submit a copy command buffer.");
-		check(_graphics_queue.waitIdle());
+		buffers[0]->copyBuffer(stage.buffer.get(), dst, 1, &copy);
+		check(buffers[0]->end());
+		auto value = uint64_t{};
+		{
+			auto lock = std::scoped_lock{_queue_mutex};
+			value = ++_graphics_timeline.reserved;
+			auto timeline_si = vk::TimelineSemaphoreSubmitInfo{
+					.waitSemaphoreValueCount = 0,
+					.pWaitSemaphoreValues = VK_NULL_HANDLE,
+					.signalSemaphoreValueCount = 1,
+					.pSignalSemaphoreValues = &value,
+			};
+			auto submit_info = vk::SubmitInfo{
+					.pNext = &timeline_si,
+					.waitSemaphoreCount = 0,
+					.pWaitSemaphores = VK_NULL_HANDLE,
+					.pWaitDstStageMask = VK_NULL_HANDLE,
+					.commandBufferCount = 1,
+					.pCommandBuffers = &buffers[0].get(),
+					.signalSemaphoreCount = 1,
+					.pSignalSemaphores = &_graphics_timeline.semaphore.get(),
+			};
+			check(
+					_graphics_queue.submit(1, &submit_info, VK_NULL_HANDLE),
+					"Failed to submit a copy command buffer.");
+		}
+		_retired.push_back(RetiredResources{
+				.value = value,
+				.buffer = std::move(stage),
+				.commands = std::move(buffers[0]),
+				.swapchain = {},
+		});
 	}
 
 	auto create_descriptor_pool() -> void
 	{
-		auto pool_sizes = array<vk::DescriptorPoolSize, 2>{
+		auto scene_textures = _settings.descriptor_buffer ? 0 : _texture_capacity;
+		auto scene_buffers = _settings.descriptor_buffer ? 0 : _buffer_capacity;
+		auto cull_sets = static_cast<uint32_t>(_cull_frames.size());
+		auto pool_sizes = array<vk::DescriptorPoolSize, 3>{
 				vk::DescriptorPoolSize{
 						.type = vk::DescriptorType::eUniformBuffer,
-						.descriptorCount = 1,
+						.descriptorCount = 1 + cull_sets,
 				},
 				vk::DescriptorPoolSize{
 						.type = vk::DescriptorType::eCombinedImageSampler,
-						.descriptorCount = 1,
+						.descriptorCount = scene_textures + cull_sets,
+				},
+				vk::DescriptorPoolSize{
+						.type = vk::DescriptorType::eStorageBuffer,
+						.descriptorCount = scene_buffers + 5 * cull_sets,
 				},
 		};
 		auto pool_ci = vk::DescriptorPoolCreateInfo{
-				.maxSets = 1,
+				.flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+				.maxSets = 1 + cull_sets,
 				.poolSizeCount = pool_sizes.size(),
 				.pPoolSizes = pool_sizes.data(),
 		};
@@ -1419,30 +3639,102 @@ class Application
 				"Failed to create a descriptor pool.");
 	}
 
+	// With descriptor buffers, only the culling sets come from the pool and
+	// the scene set is written into the descriptor ring instead. Every copy of
+	// the culling resources has a culling set of its own.
 	auto create_descriptor_sets() -> void
 	{
-		auto alloc_info = vk::DescriptorSetAllocateInfo{
-				.descriptorPool = _descriptor_pool.get(),
-				.descriptorSetCount = 1,
-				.pSetLayouts = &_descriptor_set_layout.get(),
+		auto first = _settings.descriptor_buffer ? size_t{1} : size_t{0};
+		auto cull_sets = _cull_frames.size();
+		auto layouts =
+				vector<vk::DescriptorSetLayout>(1 + cull_sets, _cull_set_layout.get());
+		layouts[0] = _descriptor_set_layout.get();
+		// Only the scene set has a variable-sized binding.
+		auto variable_counts = vector<uint32_t>(1 + cull_sets, 0);
+		variable_counts[0] = _texture_capacity;
+		auto alloc_info = vk::StructureChain<
+				vk::DescriptorSetAllocateInfo,
+				vk::DescriptorSetVariableDescriptorCountAllocateInfo>{
+				vk::DescriptorSetAllocateInfo{
+						.descriptorPool = _descriptor_pool.get(),
+						.descriptorSetCount = static_cast<uint32_t>(layouts.size() - first),
+						.pSetLayouts = &layouts[first],
+				},
+				vk::DescriptorSetVariableDescriptorCountAllocateInfo{
+						.descriptorSetCount = static_cast<uint32_t>(layouts.size() - first),
+						.pDescriptorCounts = &variable_counts[first],
+				},
 		};
 		auto sets = check(
-				_device->allocateDescriptorSets(alloc_info),
+				_device->allocateDescriptorSets(alloc_info.get()),
 				"Failed to allocate descriptor sets.");
-		_descriptor_set = sets[0];
+		if (!_settings.descriptor_buffer) {
+			_descriptor_set = sets.front();
+		}
+		for (auto i = size_t{}; i < cull_sets; ++i) {
+			_cull_frames[i].descriptor_set = sets[sets.size() - cull_sets + i];
+		}
+		if (!_settings.descriptor_buffer) {
+			auto buffer_info = vk::DescriptorBufferInfo{
+					.buffer = _uniform_buffer.buffer.get(),
+					.offset = 0,
+					.range = sizeof(UniformBufferObject),
+			};
+			_device->updateDescriptorSets(
+					vk::WriteDescriptorSet{
+							.dstSet = _descriptor_set,
+							.dstBinding = 0,
+							.dstArrayElement = 0,
+							.descriptorCount = 1,
+							.descriptorType = vk::DescriptorType::eUniformBuffer,
+							.pImageInfo = VK_NULL_HANDLE,
+							.pBufferInfo = &buffer_info,
+							.pTexelBufferView = VK_NULL_HANDLE,
+					},
+					VK_NULL_HANDLE);
+		}
+		if (_settings.culling == CullingMode::gpu) {
+			for (auto const& frame : _cull_frames) {
+				write_cull_descriptors(frame);
+			}
+		}
+		write_bindless_buffers(0, _bindless_buffers.size());
+		write_bindless_textures(0, _bindless_textures.size());
+		if (_settings.descriptor_buffer) {
+			create_descriptor_ring();
+		}
+		if (_settings.culling == CullingMode::gpu) {
+			write_occlusion_descriptors();
+		}
+	}
+
+	auto write_cull_descriptors(CullFrame const& frame) -> void
+	{
 		auto buffer_info = vk::DescriptorBufferInfo{
-				.buffer = _uniform_buffer.buffer.get(),
+				.buffer = frame.uniform_buffer.buffer.get(),
 				.offset = 0,
 				.range = sizeof(UniformBufferObject),
 		};
-		auto image_info = vk::DescriptorImageInfo{
-				.sampler = _texture_sampler.get(),
-				.imageView = _texture_image_view.get(),
-				.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+		auto storage_infos = array<vk::DescriptorBufferInfo, 3>{
+				vk::DescriptorBufferInfo{
+						.buffer = _object_buffer.buffer.get(),
+						.offset = 0,
+						.range = VK_WHOLE_SIZE,
+				},
+				vk::DescriptorBufferInfo{
+						.buffer = frame.draw_buffer.buffer.get(),
+						.offset = 0,
+						.range = VK_WHOLE_SIZE,
+				},
+				vk::DescriptorBufferInfo{
+						.buffer = frame.draw_count_buffer.buffer.get(),
+						.offset = 0,
+						.range = VK_WHOLE_SIZE,
+				},
 		};
 		auto descriptor_writes = array<vk::WriteDescriptorSet, 2>{
 				vk::WriteDescriptorSet{
-						.dstSet = _descriptor_set,
+						.dstSet = frame.descriptor_set,
 						.dstBinding = 0,
 						.dstArrayElement = 0,
 						.descriptorCount = 1,
@@ -1452,125 +3744,934 @@ class Application
 						.pTexelBufferView = VK_NULL_HANDLE,
 				},
 				vk::WriteDescriptorSet{
-						.dstSet = _descriptor_set,
+						.dstSet = frame.descriptor_set,
 						.dstBinding = 1,
 						.dstArrayElement = 0,
-						.descriptorCount = 1,
-						.descriptorType = vk::DescriptorType::eCombinedImageSampler,
-						.pImageInfo = &image_info,
-						.pBufferInfo = VK_NULL_HANDLE,
+						.descriptorCount = storage_infos.size(),
+						.descriptorType = vk::DescriptorType::eStorageBuffer,
+						.pImageInfo = VK_NULL_HANDLE,
+						.pBufferInfo = storage_infos.data(),
 						.pTexelBufferView = VK_NULL_HANDLE,
 				},
 		};
 		_device->updateDescriptorSets(descriptor_writes, VK_NULL_HANDLE);
 	}
 
-	auto create_sync_objects() -> void
+	// The scene set is kept in a ring of slots in a mapped descriptor buffer,
+	// each a full copy of the set. A frame only writes the slot it binds, so
+	// the CPU never overwrites descriptors an earlier frame may still read.
+	// Pre-recorded command buffers bind a fixed offset, so they get a single
+	// slot, which is safe because a frame waits for the previous one first.
+	auto create_descriptor_ring() -> void
 	{
-		auto semaphore_ci = vk::SemaphoreCreateInfo{};
-		auto fence_ci = vk::FenceCreateInfo{
-				.flags = vk::FenceCreateFlagBits::eSignaled,
-		};
-		_image_free = check(
-				_device->createSemaphoreUnique(semaphore_ci),
-				"Failed to create an image semaphore.");
-		_render_done_sem = check(
-				_device->createSemaphoreUnique(semaphore_ci),
-				"Failed to create an image semaphore.");
-		_render_done_fence = check(
-				_device->createFenceUnique(fence_ci),
-				"Failed to create a frame fence.");
+		auto layout = _descriptor_set_layout.get();
+		auto alignment = _device_info.descriptor_buffer_properties
+												 .descriptorBufferOffsetAlignment;
+		_descriptor_set_size = _device->getDescriptorSetLayoutSizeEXT(layout);
+		_descriptor_set_size =
+				(_descriptor_set_size + alignment - 1) / alignment * alignment;
+		for (auto i = uint32_t{}; i < _descriptor_offsets.size(); ++i) {
+			_descriptor_offsets[i] =
+					_device->getDescriptorSetLayoutBindingOffsetEXT(layout, i);
+		}
+		_descriptor_slots.resize(_settings.prerecord ? 1 : descriptor_ring_slots);
+		auto size = _descriptor_set_size * _descriptor_slots.size();
+		_descriptor_ring = create_buffer(
+				size,
+				descriptor_buffer_usage,
+				vk::MemoryPropertyFlagBits::eHostVisible |
+						vk::MemoryPropertyFlagBits::eHostCoherent);
+		check(_device->mapMemory(
+				_descriptor_ring.memory.get(),
+				0,
+				size,
+				vk::MemoryMapFlags{},
+				&_descriptor_ring_data));
+		_descriptor_ring_address = buffer_address(_descriptor_ring.buffer.get());
+		write_descriptor_slot(_descriptor_slot);
 	}
 
-	auto loop() -> void
+	// Brings a ring slot up to date with the bindless tables.
+	auto write_descriptor_slot(size_t slot) -> void
 	{
-		auto base_time = glfwGetTime();
-		auto frame_count = 0;
-		while (glfwWindowShouldClose(_window) == GLFW_FALSE) {
-			frame_count += 1;
-			auto curr_time = glfwGetTime();
-			if (curr_time > base_time + 1) {
-				print("FPS: {}\n", frame_count);
-				base_time = curr_time;
-				frame_count = 0;
-			}
-			glfwPollEvents();
-			draw_frame();
+		auto const& properties = _device_info.descriptor_buffer_properties;
+		auto& written = _descriptor_slots[slot];
+		auto* set = static_cast<std::byte*>(_descriptor_ring_data) +
+				slot * _descriptor_set_size;
+		if (!written.uniform) {
+			auto address = vk::DescriptorAddressInfoEXT{
+					.address = buffer_address(_uniform_buffer.buffer.get()),
+					.range = sizeof(UniformBufferObject),
+					.format = vk::Format::eUndefined,
+			};
+			auto data = vk::DescriptorDataEXT{};
+			data.pUniformBuffer = &address;
+			write_descriptor(
+					vk::DescriptorType::eUniformBuffer,
+					data,
+					properties.uniformBufferDescriptorSize,
+					set + _descriptor_offsets[0]);
+			written.uniform = true;
+		}
+		for (; written.buffers < _bindless_buffers.size(); ++written.buffers) {
+			auto const& info = _bindless_buffers[written.buffers];
+			auto address = vk::DescriptorAddressInfoEXT{
+					.address = buffer_address(info.buffer) + info.offset,
+					.range = info.range,
+					.format = vk::Format::eUndefined,
+			};
+			auto data = vk::DescriptorDataEXT{};
+			data.pStorageBuffer = &address;
+			auto size = properties.storageBufferDescriptorSize;
+			write_descriptor(
+					vk::DescriptorType::eStorageBuffer,
+					data,
+					size,
+					set + _descriptor_offsets[1] + written.buffers * size);
+		}
+		for (; written.textures < _bindless_textures.size(); ++written.textures) {
+			auto data = vk::DescriptorDataEXT{};
+			data.pCombinedImageSampler = &_bindless_textures[written.textures];
+			auto size = properties.combinedImageSamplerDescriptorSize;
+			write_descriptor(
+					vk::DescriptorType::eCombinedImageSampler,
+					data,
+					size,
+					set + _descriptor_offsets[2] + written.textures * size);
 		}
-		check(_device->waitIdle());
 	}
 
-	auto draw_frame() -> void
+	auto write_descriptor(
+			vk::DescriptorType type,
+			vk::DescriptorDataEXT const& data,
+			size_t size,
+			std::byte* destination) -> void
 	{
-		check(
-				_device->waitForFences(_render_done_fence.get(), VK_TRUE, UINT64_MAX));
-		check(_device->resetFences(1, &_render_done_fence.get()));
-		update_uniform();
-		auto image_index = check(
-				_device->acquireNextImageKHR(
-						_swapchain.get(),
-						UINT64_MAX,
-						_image_free.get(),
-						VK_NULL_HANDLE),
-				"Failed to acquire next image.");
-		check(_command_buffer->reset());
-		record_command_buffer(_command_buffer.get(), image_index);
-		auto signal_semaphores = array<vk::Semaphore, 1>{_render_done_sem.get()};
-		auto wait_semaphores = array<vk::Semaphore, 1>{_image_free.get()};
-		auto wait_staged = array<vk::PipelineStageFlags, 1>{
-				vk::PipelineStageFlagBits::eColorAttachmentOutput};
-		auto submit_info = vk::SubmitInfo{
-				.waitSemaphoreCount = wait_semaphores.size(),
-				.pWaitSemaphores = wait_semaphores.data(),
-				.pWaitDstStageMask = wait_staged.data(),
-				.commandBufferCount = 1,
-				.pCommandBuffers = &_command_buffer.get(),
-				.signalSemaphoreCount = signal_semaphores.size(),
-				.pSignalSemaphores = signal_semaphores.data(),
+		auto info = vk::DescriptorGetInfoEXT{
+				.type = type,
+				.data = data,
 		};
-		check(
-				_graphics_queue.submit(1, &submit_info, _render_done_fence.get()),
-				"Failed to submit a draw command buffer.");
-		auto swapchains = array<vk::SwapchainKHR, 1>{_swapchain.get()};
-		auto present_info = vk::PresentInfoKHR{
-				.waitSemaphoreCount = signal_semaphores.size(),
-				.pWaitSemaphores = signal_semaphores.data(),
-				.swapchainCount = swapchains.size(),
+		_device->getDescriptorEXT(&info, size, destination);
+	}
+
+	auto buffer_address(vk::Buffer buffer) -> vk::DeviceAddress
+	{
+		return _device->getBufferAddress(vk::BufferDeviceAddressInfo{
+				.buffer = buffer,
+		});
+	}
+
+	// Buffers whose descriptors may be written into a descriptor buffer need a
+	// device address.
+	auto descriptor_buffer_flags() const -> vk::BufferUsageFlags
+	{
+		if (!_settings.descriptor_buffer) {
+			return {};
+		}
+		return vk::BufferUsageFlagBits::eShaderDeviceAddress;
+	}
+
+	// Adds a storage buffer of `size` bytes to the bindless table and returns
+	// the index shaders read it by.
+	auto add_buffer(vk::Buffer buffer, vk::DeviceSize size) -> uint32_t
+	{
+		if (_bindless_buffers.size() == _buffer_capacity) {
+			fail("The bindless buffer table is full.");
+		}
+		_bindless_buffers.push_back(vk::DescriptorBufferInfo{
+				.buffer = buffer,
+				.offset = 0,
+				.range = size,
+		});
+		write_bindless_buffers(_bindless_buffers.size() - 1, 1);
+		return static_cast<uint32_t>(_bindless_buffers.size() - 1);
+	}
+
+	// Adds a sampled texture to the bindless table and returns the index
+	// objects refer to it by.
+	auto add_texture(vk::ImageView view, vk::Sampler sampler) -> uint32_t
+	{
+		if (_bindless_textures.size() == _texture_capacity) {
+			fail("The bindless texture table is full.");
+		}
+		_bindless_textures.push_back(vk::DescriptorImageInfo{
+				.sampler = sampler,
+				.imageView = view,
+				.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+		});
+		write_bindless_textures(_bindless_textures.size() - 1, 1);
+		return static_cast<uint32_t>(_bindless_textures.size() - 1);
+	}
+
+	auto write_bindless_buffers(size_t first, size_t count) -> void
+	{
+		if (!_descriptor_set || count == 0) {
+			return;
+		}
+		_device->updateDescriptorSets(
+				vk::WriteDescriptorSet{
+						.dstSet = _descriptor_set,
+						.dstBinding = 1,
+						.dstArrayElement = static_cast<uint32_t>(first),
+						.descriptorCount = static_cast<uint32_t>(count),
+						.descriptorType = vk::DescriptorType::eStorageBuffer,
+						.pImageInfo = VK_NULL_HANDLE,
+						.pBufferInfo = &_bindless_buffers[first],
+						.pTexelBufferView = VK_NULL_HANDLE,
+				},
+				VK_NULL_HANDLE);
+	}
+
+	auto write_bindless_textures(size_t first, size_t count) -> void
+	{
+		if (!_descriptor_set || count == 0) {
+			return;
+		}
+		_device->updateDescriptorSets(
+				vk::WriteDescriptorSet{
+						.dstSet = _descriptor_set,
+						.dstBinding = 2,
+						.dstArrayElement = static_cast<uint32_t>(first),
+						.descriptorCount = static_cast<uint32_t>(count),
+						.descriptorType = vk::DescriptorType::eCombinedImageSampler,
+						.pImageInfo = &_bindless_textures[first],
+						.pBufferInfo = VK_NULL_HANDLE,
+						.pTexelBufferView = VK_NULL_HANDLE,
+				},
+				VK_NULL_HANDLE);
+	}
+
+	auto write_occlusion_descriptors() -> void
+	{
+		for (auto const& frame : _cull_frames) {
+			write_occlusion_descriptors(frame);
+		}
+	}
+
+	auto write_occlusion_descriptors(CullFrame const& frame) -> void
+	{
+		auto visibility_info = vk::DescriptorBufferInfo{
+				.buffer = frame.visibility_buffer.buffer.get(),
+				.offset = 0,
+				.range = VK_WHOLE_SIZE,
+		};
+		auto hiz_info = vk::DescriptorImageInfo{
+				.sampler = _hiz_sampler.get(),
+				.imageView = _hiz_image_view.get(),
+				.imageLayout = vk::ImageLayout::eGeneral,
+		};
+		auto statistics_info = vk::DescriptorBufferInfo{
+				.buffer = frame.statistics_buffer.buffer.get(),
+				.offset = 0,
+				.range = VK_WHOLE_SIZE,
+		};
+		auto descriptor_writes = array<vk::WriteDescriptorSet, 3>{
+				vk::WriteDescriptorSet{
+						.dstSet = frame.descriptor_set,
+						.dstBinding = 4,
+						.dstArrayElement = 0,
+						.descriptorCount = 1,
+						.descriptorType = vk::DescriptorType::eStorageBuffer,
+						.pImageInfo = VK_NULL_HANDLE,
+						.pBufferInfo = &visibility_info,
+						.pTexelBufferView = VK_NULL_HANDLE,
+				},
+				vk::WriteDescriptorSet{
+						.dstSet = frame.descriptor_set,
+						.dstBinding = 5,
+						.dstArrayElement = 0,
+						.descriptorCount = 1,
+						.descriptorType = vk::DescriptorType::eCombinedImageSampler,
+						.pImageInfo = &hiz_info,
+						.pBufferInfo = VK_NULL_HANDLE,
+						.pTexelBufferView = VK_NULL_HANDLE,
+				},
+				vk::WriteDescriptorSet{
+						.dstSet = frame.descriptor_set,
+						.dstBinding = 6,
+						.dstArrayElement = 0,
+						.descriptorCount = 1,
+						.descriptorType = vk::DescriptorType::eStorageBuffer,
+						.pImageInfo = VK_NULL_HANDLE,
+						.pBufferInfo = &statistics_info,
+						.pTexelBufferView = VK_NULL_HANDLE,
+				},
+		};
+		_device->updateDescriptorSets(descriptor_writes, VK_NULL_HANDLE);
+	}
+
+	// Presentation only works with binary semaphores, so acquiring and
+	// presenting still use them; everything else goes through the timelines.
+	auto create_sync_objects() -> void
+	{
+		auto semaphore_ci = vk::SemaphoreCreateInfo{};
+		_image_free = check(
+				_device->createSemaphoreUnique(semaphore_ci),
+				"Failed to create an image semaphore.");
+		_render_done_sem = check(
+				_device->createSemaphoreUnique(semaphore_ci),
+				"Failed to create an image semaphore.");
+	}
+
+	auto loop() -> void
+	{
+		_start_time = glfwGetTime();
+		_fps_base_time = _start_time;
+		_fps_allocations = heap_allocation_count();
+		_fps_cpu_time = std::clock();
+		if (_settings.render_thread) {
+			run_render_thread();
+		} else {
+			while (glfwWindowShouldClose(_window) == GLFW_FALSE) {
+				report_frame_rate();
+				pace_frame();
+				_limiter.wait();
+				wait_for_events(0);
+				auto snapshot = simulate();
+				if (!needs_redraw(snapshot)) {
+					continue;
+				}
+				_shown_view = snapshot.view;
+				_fps_frames += 1;
+				draw_frame(snapshot);
+			}
+		}
+		check(_device->waitIdle());
+	}
+
+	// In render-on-demand mode, polls while frames are due and otherwise blocks
+	// until an event arrives or, while unfocused, the next background frame.
+	// `timeout` bounds the wait while there is something to show.
+	auto wait_for_events(double timeout) -> void
+	{
+		if (_settings.on_demand &&
+				(_iconified.load(std::memory_order_relaxed) || _paused)) {
+			glfwWaitEventsTimeout(idle_timeout);
+		} else if (
+				_settings.on_demand && !_focused.load(std::memory_order_relaxed)) {
+			glfwWaitEventsTimeout(background_interval);
+		} else if (timeout > 0) {
+			glfwWaitEventsTimeout(timeout);
+		} else {
+			glfwPollEvents();
+		}
+	}
+
+	// Whether drawing `snapshot` would change what the window shows. A
+	// minimized window shows nothing, and otherwise the last image stays on
+	// screen until the view changes, the swapchain is rebuilt or the window
+	// system asks for the contents again.
+	auto needs_redraw(FrameSnapshot const& snapshot) -> bool
+	{
+		if (!_settings.on_demand) {
+			return true;
+		}
+		if (_iconified.load(std::memory_order_relaxed)) {
+			return false;
+		}
+		return _redraw.exchange(false, std::memory_order_relaxed) ||
+				_swapchain_dirty.load(std::memory_order_relaxed) ||
+				snapshot.view != _shown_view;
+	}
+
+	auto print_pipeline_stats() -> void
+	{
+		print(
+				"pipelines: {} cached, {} hits, {} misses, {} linked on first use\n",
+				_pipelines.size(),
+				_pipeline_hits,
+				_pipeline_misses,
+				_pipelines_linked);
+	}
+
+	// Called once per loop iteration, whether or not it drew a frame, so that
+	// idle periods are reported too. Per-frame averages cover the frames drawn.
+	auto report_frame_rate() -> void
+	{
+		auto curr_time = glfwGetTime();
+		if (curr_time <= _fps_base_time + 1) {
+			return;
+		}
+		auto frames = std::max(_fps_frames, 1u);
+		if (_settings.occlusion_culling) {
+			print(
+					"FPS: {} occluded: {}/{}\n",
+					_fps_frames,
+					_occluded_objects / frames,
+					_objects.size());
+			_occluded_objects = 0;
+		} else {
+			print("FPS: {}\n", _fps_frames);
+		}
+		if (_settings.record_threads > 0) {
+			print(
+					"record: {:.3f} ms on {} threads\n",
+					1000.0 * _record_time / frames,
+					_settings.record_threads);
+			_record_time = 0;
+		}
+		if (_settings.present_wait && _presents_timed > 0) {
+			print(
+					"present: {:.3f} ms after acquire, {} missed of {:.3f} ms, "
+					"delay {:.3f} ms\n",
+					1000.0 * _present_latency / _presents_timed,
+					_missed_intervals,
+					1000.0 * _refresh_interval,
+					1000.0 * _pacing_delay);
+			_present_latency = 0;
+			_presents_timed = 0;
+			_missed_intervals = 0;
+		}
+		if (_settings.target_fps > 0) {
+			print(
+					"limiter: {} fps, at worst {:.1f} us late\n",
+					_settings.target_fps,
+					static_cast<double>(_limiter.worst_lateness()) / 1000.0);
+			_limiter.reset_worst_lateness();
+		}
+		if (_timestamp_pool && _settings.async_compute) {
+			print(
+					"cull: {:.3f} ms render: {:.3f} ms overlapped: {:.3f} ms\n",
+					_compute_time / frames,
+					_graphics_time / frames,
+					_overlap_time / frames);
+			_compute_time = 0;
+			_graphics_time = 0;
+			_overlap_time = 0;
+		} else if (_timestamp_pool) {
+			print("render: {:.3f} ms\n", _graphics_time / frames);
+			_graphics_time = 0;
+		}
+		if (_settings.hot_reload) {
+			print_pipeline_stats();
+		}
+		// Includes anything the main thread allocates while the render thread
+		// draws, so it only reads zero once both are allocation-free.
+		if (_settings.report_allocations) {
+			auto allocations = heap_allocation_count();
+			print(
+					"heap allocations: {:.2f}/frame, frame arena: {} KiB\n",
+					static_cast<double>(allocations - _fps_allocations) / frames,
+					_frame_arena_peak >> 10);
+			_fps_allocations = heap_allocation_count();
+		}
+		// Process CPU time over wall time, so it covers every thread and shows
+		// what an idle window still costs.
+		if (_settings.on_demand) {
+			auto cpu_time = std::clock();
+			print(
+					"cpu: {:.1f}% of a core\n",
+					100.0 * static_cast<double>(cpu_time - _fps_cpu_time) /
+							CLOCKS_PER_SEC / (curr_time - _fps_base_time));
+			_fps_cpu_time = cpu_time;
+		}
+		_fps_base_time = curr_time;
+		_fps_frames = 0;
+	}
+
+	// The main thread keeps handling events and simulating, so blocking in
+	// acquire or present no longer delays input, while the render thread
+	// draws whichever snapshot is the newest.
+	auto run_render_thread() -> void
+	{
+		_shown_view = simulate().view;
+		_snapshots.try_push(simulate());
+		auto renderer = std::thread{[this] { render_main(); }};
+		while (glfwWindowShouldClose(_window) == GLFW_FALSE) {
+			wait_for_events(simulation_interval);
+			auto snapshot = simulate();
+			if (needs_redraw(snapshot)) {
+				if (_snapshots.try_push(snapshot)) {
+					_shown_view = snapshot.view;
+				} else {
+					_redraw.store(true, std::memory_order_relaxed);
+				}
+			}
+		}
+		// A render-on-demand renderer may be blocked waiting for a snapshot, and
+		// any renderer waiting for a minimized window to be restored.
+		_rendering.store(false, std::memory_order_relaxed);
+		_snapshots.try_push(simulate());
+		_swapchain_dirty.store(true, std::memory_order_relaxed);
+		_swapchain_dirty.notify_one();
+		renderer.join();
+		_jobs.adopt_current_thread();
+	}
+
+	auto render_main() -> void
+	{
+		_jobs.adopt_current_thread();
+		auto submitter = std::thread{};
+		if (_settings.submit_thread) {
+			submitter = std::thread{[this] { submit_main(); }};
+		}
+		auto snapshot = _snapshots.pop();
+		while (_rendering.load(std::memory_order_relaxed)) {
+			pace_frame();
+			_limiter.wait();
+			while (auto newer = _snapshots.try_pop()) {
+				snapshot = newer.value();
+			}
+			report_frame_rate();
+			_fps_frames += 1;
+			draw_frame(snapshot);
+			// The main thread only publishes snapshots that change the image.
+			if (_settings.on_demand) {
+				snapshot = _snapshots.pop();
+			}
+		}
+		if (submitter.joinable()) {
+			wait_for_presentation();
+			_submissions.try_push(SubmitRequest{
+					.buffer = VK_NULL_HANDLE,
+					.image_index = 0,
+					.compute_value = 0,
+					.stop = true,
+			});
+			submitter.join();
+		}
+	}
+
+	auto submit_main() -> void
+	{
+		while (true) {
+			auto request = _submissions.pop();
+			if (request.stop) {
+				return;
+			}
+			submit_frame(request);
+			_presented_frames.fetch_add(1, std::memory_order_release);
+			_presented_frames.notify_one();
+		}
+	}
+
+	auto wait_for_presentation() -> void
+	{
+		auto presented = _presented_frames.load(std::memory_order_acquire);
+		while (presented != _submitted_frames) {
+			_presented_frames.wait(presented, std::memory_order_acquire);
+			presented = _presented_frames.load(std::memory_order_acquire);
+		}
+	}
+
+	auto update_frame(FrameSnapshot const& snapshot) -> void
+	{
+		set_allocation_phase(AllocationPhase::update);
+		update_uniform(snapshot);
+		if (_settings.culling == CullingMode::cpu) {
+			cull_objects();
+		}
+		if (_settings.async_compute && !_culling_submitted) {
+			submit_culling();
+		}
+	}
+
+	// With async compute, culls the next frame into the copy of the culling
+	// resources the previous frame is not drawing from, before waiting for
+	// that frame, so the compute queue works on it while the graphics queue is
+	// still busy. The copy was last drawn from two frames ago, which has
+	// finished. With late latching, the view is only known after acquiring,
+	// so culling waits for update_frame.
+	auto cull_ahead(FrameSnapshot const& snapshot) -> void
+	{
+		if (!_settings.async_compute || _settings.late_latch ||
+				_culling_submitted) {
+			return;
+		}
+		set_allocation_phase(AllocationPhase::update);
+		sync_frame_value();
+		wait_for_graphics(_cull_frames[_cull_frame].frame_value);
+		update_cull_uniform(snapshot);
+		submit_culling();
+	}
+
+	// Acquiring may block until an image frees up, so the state sampled at the
+	// start of the frame can be stale by the time it is recorded. Events can
+	// only be polled on the main thread, so a render thread takes the newest
+	// snapshot the main thread has published instead.
+	auto latch_snapshot(FrameSnapshot const& snapshot) -> FrameSnapshot
+	{
+		if (_settings.render_thread) {
+			auto latest = snapshot;
+			while (auto newer = _snapshots.try_pop()) {
+				latest = newer.value();
+			}
+			return latest;
+		}
+		glfwPollEvents();
+		return simulate();
+	}
+
+	// Waits until the previous frame is on the display, so that no more than
+	// one frame queues for presentation, then holds the next one back. The
+	// delay grows while frames make every refresh and halves after a miss,
+	// starting each frame as late as a steady rate allows.
+	auto pace_frame() -> void
+	{
+		sync_frame_value();
+		if (!_settings.present_wait || _present_id == 0 ||
+				_present_id == _paced_id) {
+			return;
+		}
+		_paced_id = _present_id;
+		if (_settings.submit_thread) {
+			wait_for_presentation();
+		}
+		auto result = _device->waitForPresentKHR(
+				_swapchain.get(),
+				_present_id,
+				present_wait_timeout);
+		if (result != vk::Result::eSuccess) {
+			return;
+		}
+		auto now = glfwGetTime();
+		_present_latency += now - _present_acquire_time;
+		_presents_timed += 1;
+		if (_last_present_time > 0) {
+			auto interval = now - _last_present_time;
+			if (_refresh_interval == 0) {
+				_refresh_interval = interval;
+			} else if (interval > 1.5 * _refresh_interval) {
+				_missed_intervals += 1;
+				_pacing_delay /= 2;
+			} else {
+				_refresh_interval += (interval - _refresh_interval) * 0.05;
+				_pacing_delay =
+						std::min(_pacing_delay + pacing_step, 0.75 * _refresh_interval);
+			}
+		}
+		_last_present_time = now;
+		std::this_thread::sleep_for(std::chrono::duration<double>{_pacing_delay});
+	}
+
+	// With late latching, `snapshot` is replaced by the newest state once the
+	// image has been acquired.
+	auto draw_frame(FrameSnapshot& snapshot) -> void
+	{
+		cull_ahead(snapshot);
+		set_allocation_phase(AllocationPhase::wait);
+		wait_for_frame();
+		destroy_retired(_frame_value);
+		collect_pipelines();
+		reload_shaders();
+		_scene_pipeline = find_pipeline(_scene_desc);
+		read_timestamps();
+		if (_settings.descriptor_buffer) {
+			_descriptor_slot = (_descriptor_slot + 1) % _descriptor_slots.size();
+			write_descriptor_slot(_descriptor_slot);
+		}
+		if (_swapchain_dirty.exchange(false, std::memory_order_relaxed) &&
+				!recreate_swapchain()) {
+			set_allocation_phase(AllocationPhase::idle);
+			return;
+		}
+		// The frame waited for above is the last one that can have drawn from
+		// either copy, so this frame's arena is free again.
+		auto& arena = *_cull_frames[_cull_frame].arena;
+		_frame_arena_peak = std::max(_frame_arena_peak, arena.used());
+		arena.reset();
+		if (_settings.occlusion_culling) {
+			_occluded_objects += *static_cast<uint32_t*>(
+					_cull_frames[_last_cull_frame].statistics_data);
+		}
+		if (!_settings.late_latch) {
+			update_frame(snapshot);
+		}
+		set_allocation_phase(AllocationPhase::acquire);
+		if (_settings.submit_thread) {
+			wait_for_presentation();
+		}
+		auto [acquired, image_index] = _device->acquireNextImageKHR(
+				_swapchain.get(),
+				UINT64_MAX,
+				_image_free.get(),
+				VK_NULL_HANDLE);
+		if (acquired == vk::Result::eErrorOutOfDateKHR) {
+			_swapchain_dirty.store(true, std::memory_order_relaxed);
+			set_allocation_phase(AllocationPhase::idle);
+			return;
+		}
+		if (acquired == vk::Result::eSuboptimalKHR) {
+			_swapchain_dirty.store(true, std::memory_order_relaxed);
+		} else {
+			check(acquired, "Failed to acquire next image.");
+		}
+		_acquire_time = glfwGetTime();
+		if (_settings.late_latch) {
+			snapshot = latch_snapshot(snapshot);
+			update_frame(snapshot);
+		}
+		set_allocation_phase(AllocationPhase::record);
+		auto buffer = _command_buffer.get();
+		auto const& cull = _cull_frames[_cull_frame];
+		if (_settings.prerecord) {
+			if (_commands_dirty) {
+				record_command_buffers();
+			}
+			buffer = _prerecorded_buffers
+					[_cull_frame * _swapchain_images.size() + image_index]
+							.get();
+		} else {
+			check(buffer.reset());
+			record_command_buffer(buffer, image_index, cull);
+		}
+		set_allocation_phase(AllocationPhase::submit);
+		auto request = SubmitRequest{
+				.buffer = buffer,
+				.image_index = image_index,
+				.compute_value = _settings.async_compute ? cull.compute_value : 0,
+				.stop = false,
+		};
+		if (_settings.submit_thread) {
+			_submitted_frames += 1;
+			_submissions.try_push(request);
+		} else {
+			submit_frame(request);
+		}
+		_frame_pending = true;
+		_last_cull_frame = _cull_frame;
+		_cull_frame = (_cull_frame + 1) % _cull_frames.size();
+		_culling_submitted = false;
+		set_allocation_phase(AllocationPhase::idle);
+	}
+
+	// Earlier submissions to the graphics queue, such as copies, are ordered
+	// before the frame by the barrier at the start of its commands, so it only
+	// waits for the image and for the frame's culling on the compute queue.
+	// Reserves the frame's timeline value and publishes it once submitted.
+	auto submit_frame(SubmitRequest const& request) -> void
+	{
+		auto signal_semaphores = array<vk::Semaphore, 2>{
+				_render_done_sem.get(),
+				_graphics_timeline.semaphore.get()};
+		auto signal_values = array<uint64_t, 2>{};
+		auto wait_semaphores = array<vk::Semaphore, 2>{
+				_image_free.get(),
+				_compute_timeline.semaphore.get()};
+		auto wait_values = array<uint64_t, 2>{0, request.compute_value};
+		auto wait_staged = array<vk::PipelineStageFlags, 2>{
+				vk::PipelineStageFlagBits::eColorAttachmentOutput,
+				vk::PipelineStageFlagBits::eDrawIndirect |
+						vk::PipelineStageFlagBits::eComputeShader};
+		auto wait_count = request.compute_value == 0 ? uint32_t{1} : uint32_t{2};
+		auto timeline_si = vk::TimelineSemaphoreSubmitInfo{
+				.waitSemaphoreValueCount = wait_count,
+				.pWaitSemaphoreValues = wait_values.data(),
+				.signalSemaphoreValueCount = signal_values.size(),
+				.pSignalSemaphoreValues = signal_values.data(),
+		};
+		auto submit_info = vk::SubmitInfo{
+				.pNext = &timeline_si,
+				.waitSemaphoreCount = wait_count,
+				.pWaitSemaphores = wait_semaphores.data(),
+				.pWaitDstStageMask = wait_staged.data(),
+				.commandBufferCount = 1,
+				.pCommandBuffers = &request.buffer,
+				.signalSemaphoreCount = signal_semaphores.size(),
+				.pSignalSemaphores = signal_semaphores.data(),
+		};
+		auto& value = signal_values[1];
+		{
+			auto lock = std::scoped_lock{_queue_mutex};
+			value = ++_graphics_timeline.reserved;
+			check(
+					_graphics_queue.submit(1, &submit_info, VK_NULL_HANDLE),
+					"Failed to submit a draw command buffer.");
+		}
+		_submitted_value.store(value, std::memory_order_release);
+		_submitted_value.notify_one();
+		auto swapchains = array<vk::SwapchainKHR, 1>{_swapchain.get()};
+		auto present_id = vk::PresentIdKHR{
+				.swapchainCount = 1,
+				.pPresentIds = &value,
+		};
+		auto present_info = vk::PresentInfoKHR{
+				.pNext = _settings.present_wait ? &present_id : VK_NULL_HANDLE,
+				.waitSemaphoreCount = 1,
+				.pWaitSemaphores = &_render_done_sem.get(),
+				.swapchainCount = swapchains.size(),
 				.pSwapchains = swapchains.data(),
-				.pImageIndices = &image_index,
+				.pImageIndices = &request.image_index,
 				.pResults = VK_NULL_HANDLE,
 		};
-		check(_present_queue.presentKHR(present_info));
+		// Uploads submit to the graphics queue from job threads, so presenting
+		// on the same queue needs the mutex too.
+		auto lock = std::unique_lock{_queue_mutex, std::defer_lock};
+		if (_present_queue == _graphics_queue) {
+			lock.lock();
+		}
+		auto presented = _present_queue.presentKHR(present_info);
+		if (lock) {
+			lock.unlock();
+		}
+		if (presented == vk::Result::eErrorOutOfDateKHR ||
+				presented == vk::Result::eSuboptimalKHR) {
+			_swapchain_dirty.store(true, std::memory_order_relaxed);
+		} else {
+			check(presented, "Failed to present.");
+		}
+		if (!_first_frame_presented) {
+			_first_frame_presented = true;
+			print(
+					"first frame: presented {:.3f} ms after launch\n",
+					1000.0 * (glfwGetTime() - _launch_time));
+		}
 	}
 
-	auto update_uniform() -> void
+	// Rebuilds what depends on the swapchain once the previous frame has
+	// finished, without idling the device: the old swapchain is handed over
+	// as oldSwapchain, and the depth image is only reallocated when it no
+	// longer fits. Returns false while the window has no area to draw to.
+	auto recreate_swapchain() -> bool
 	{
-		static auto start = glfwGetTime();
-		auto now = glfwGetTime();
-		auto time = static_cast<float>(now - start);
-		auto ubo = UniformBufferObject{
-				.model = glm::rotate(
-						glm::mat4{1.0f},
-						time * glm::radians(90.0f),
-						glm::vec3{0.0f, 0.0f, 1.0f}),
+		if (_settings.submit_thread) {
+			wait_for_presentation();
+		}
+		_swapchain_details.capabilities = check(
+				_physical_device.getSurfaceCapabilitiesKHR(_surface.get()));
+		auto extent = choose_swapchain_extent(_swapchain_details.capabilities);
+		if (extent.width == 0 || extent.height == 0) {
+			wait_for_window_area();
+			return false;
+		}
+		auto resized = extent != _swapchain_extent;
+		create_swapchain();
+		create_image_views();
+		allocate_prerecorded_buffers();
+		create_depth_resources();
+		if (resized && _settings.occlusion_culling) {
+			// Culling for the next frame may already be running with the sets and
+			// commands about to be replaced.
+			if (_settings.async_compute) {
+				wait_for_compute(_compute_timeline.reserved);
+			}
+			create_hiz_resources();
+			write_occlusion_descriptors();
+			if (_settings.async_compute) {
+				record_compute_commands();
+			}
+		}
+		// Present ids count per swapchain.
+		_present_id = 0;
+		_last_present_time = 0;
+		return true;
+	}
+
+	// A minimized window has no area until it is restored, which the resize
+	// callback announces by marking the swapchain dirty. Rather than retrying
+	// every frame, the main thread blocks for events, and a render thread for
+	// the callback or shutdown to set the flag.
+	auto wait_for_window_area() -> void
+	{
+		if (_settings.render_thread) {
+			_swapchain_dirty.wait(false, std::memory_order_relaxed);
+		} else {
+			glfwWaitEvents();
+			_swapchain_dirty.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	// The camera orbits the scene, so the model matrix pushed with each draw
+	// stays constant.
+	[[nodiscard]] auto simulate() const -> FrameSnapshot
+	{
+		auto now = _paused ? _pause_time : glfwGetTime();
+		auto time = static_cast<float>(now - _start_time - _paused_time);
+		auto eye = glm::rotate(
+				glm::mat4{1.0f},
+				-time * glm::radians(90.0f),
+				glm::vec3{0.0f, 0.0f, 1.0f}) *
+				glm::vec4{2.0f, 2.0f, 2.0f, 1.0f};
+		return FrameSnapshot{
 				.view = glm::lookAt(
-						glm::vec3{2.0f, 2.0f, 2.0f},
+						glm::vec3{eye},
 						glm::vec3{0.0f, 0.0f, 0.0f},
 						glm::vec3{0.0f, 0.0f, 1.0f}),
-				.proj = glm::perspective(
-						glm::radians(45.0f),
-						static_cast<float>(_swapchain_extent.width) /
-								static_cast<float>(_swapchain_extent.height),
-						0.1f,
-						10.0f),
-		};
-		ubo.proj[1][1] *= -1;
+		};
+	}
+
+	[[nodiscard]] auto frame_uniform(FrameSnapshot const& snapshot) const
+			-> UniformBufferObject
+	{
+		auto proj = glm::perspective(
+				glm::radians(45.0f),
+				static_cast<float>(_swapchain_extent.width) /
+						static_cast<float>(_swapchain_extent.height),
+				0.1f,
+				10.0f);
+		proj[1][1] *= -1;
+		auto ubo = UniformBufferObject{
+				.view_proj = proj * snapshot.view,
+				.frustum = {},
+		};
+		ubo.frustum = frustum_planes(ubo.view_proj * _model);
+		return ubo;
+	}
+
+	auto update_uniform(FrameSnapshot const& snapshot) -> void
+	{
+		auto ubo = frame_uniform(snapshot);
+		_frustum = ubo.frustum;
 		memcpy(_uniform_data, &ubo, sizeof(ubo));
+		if (_settings.culling == CullingMode::gpu && !_culling_submitted) {
+			memcpy(_cull_frames[_cull_frame].uniform_data, &ubo, sizeof(ubo));
+		}
+	}
+
+	auto update_cull_uniform(FrameSnapshot const& snapshot) -> void
+	{
+		auto ubo = frame_uniform(snapshot);
+		memcpy(_cull_frames[_cull_frame].uniform_data, &ubo, sizeof(ubo));
+	}
+
+	// CPU counterpart of record_culling for devices or scenes where the compute
+	// pass is not wanted.
+	auto cull_objects() -> void
+	{
+		auto count = cull_parallel(
+				_frustum,
+				_bounds,
+				BoundingVolume::sphere,
+				_visible,
+				_jobs);
+		_visible_count = count;
+		auto const& frame = _cull_frames[_cull_frame];
+		auto* draws =
+				static_cast<vk::DrawIndexedIndirectCommand*>(frame.draw_data);
+		for (auto i = size_t{}; i < count; ++i) {
+			draws[i] = vk::DrawIndexedIndirectCommand{
+					.indexCount = static_cast<uint32_t>(_indices.size()),
+					.instanceCount = 1,
+					.firstIndex = 0,
+					.vertexOffset = 0,
+					.firstInstance = _visible[i],
+			};
+		}
+		auto draw_count = static_cast<uint32_t>(count);
+		memcpy(frame.draw_count_data, &draw_count, sizeof(draw_count));
+	}
+
+	// Everything that varies per frame reaches the GPU through the uniform,
+	// draw and count buffers, so the recorded commands stay valid until
+	// _commands_dirty is set. Only called once draw_frame has waited for the
+	// previous frame's timeline value, so none of the buffers are pending.
+	auto record_command_buffers() -> void
+	{
+		auto images = _swapchain_images.size();
+		for (auto i = size_t{0}; i < _prerecorded_buffers.size(); ++i) {
+			check(_prerecorded_buffers[i]->reset());
+			record_command_buffer(
+					_prerecorded_buffers[i].get(),
+					static_cast<uint32_t>(i % images),
+					_cull_frames[i / images]);
+		}
+		_commands_dirty = false;
 	}
 
 	auto record_command_buffer(
 			vk::CommandBuffer const& buffer,
-			uint32_t image_index) -> void
+			uint32_t image_index,
+			CullFrame const& cull) -> void
 	{
 		auto command_buffer_bi = vk::CommandBufferBeginInfo{
 				.pInheritanceInfo = VK_NULL_HANDLE,
@@ -1590,7 +4691,8 @@ class Application
 				.resolveMode = vk::ResolveModeFlagBits::eNone,
 				.resolveImageLayout = vk::ImageLayout::eUndefined,
 				.loadOp = vk::AttachmentLoadOp::eClear,
-				.storeOp = vk::AttachmentStoreOp::eDontCare,
+				.storeOp = _settings.occlusion_culling ? vk::AttachmentStoreOp::eStore
+																							 : vk::AttachmentStoreOp::eDontCare,
 				.clearValue = vk::ClearValue{{array<float, 4>{1.0, 0.0, 0.0, 0.0}}},
 		};
 		auto render_info = vk::RenderingInfo{
@@ -1607,7 +4709,7 @@ class Application
 				.pStencilAttachment = VK_NULL_HANDLE,
 		};
 		auto depth_write_barrier = vk::ImageMemoryBarrier{
-				.srcAccessMask = vk::AccessFlagBits::eNone,
+				.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite,
 				.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite |
 						vk::AccessFlagBits::eDepthStencilAttachmentRead,
 				.oldLayout = vk::ImageLayout::eUndefined,
@@ -1661,63 +4763,1033 @@ class Application
 		check(
 				buffer.begin(command_buffer_bi),
 				"Failed to begin recording a command buffer.");
+		if (_timestamp_pool) {
+			buffer.resetQueryPool(_timestamp_pool.get(), graphics_timestamps, 2);
+			buffer.writeTimestamp(
+					vk::PipelineStageFlagBits::eTopOfPipe,
+					_timestamp_pool.get(),
+					graphics_timestamps);
+		}
+		record_frame_barrier(buffer);
+		if (_settings.culling == CullingMode::gpu && !_settings.async_compute) {
+			record_culling(buffer, first_cull_phase(), cull);
+			record_draw_barrier(buffer);
+		}
+		// Chains with the wait for the image to be acquired.
 		buffer.pipelineBarrier(
-				vk::PipelineStageFlagBits::eTopOfPipe,
+				vk::PipelineStageFlagBits::eColorAttachmentOutput,
 				vk::PipelineStageFlagBits::eColorAttachmentOutput,
 				vk::DependencyFlags{},
 				VK_NULL_HANDLE,
 				VK_NULL_HANDLE,
 				color_write_barrier);
+		// The previous frame may still be drawing to or reducing the depth image.
 		buffer.pipelineBarrier(
-				vk::PipelineStageFlagBits::eTopOfPipe,
+				vk::PipelineStageFlagBits::eEarlyFragmentTests |
+						vk::PipelineStageFlagBits::eLateFragmentTests |
+						vk::PipelineStageFlagBits::eComputeShader,
 				vk::PipelineStageFlagBits::eEarlyFragmentTests |
 						vk::PipelineStageFlagBits::eLateFragmentTests,
 				vk::DependencyFlags{},
 				VK_NULL_HANDLE,
 				VK_NULL_HANDLE,
 				depth_write_barrier);
-		buffer.beginRendering(&render_info);
-		buffer.bindPipeline(
-				vk::PipelineBindPoint::eGraphics,
-				_graphics_pipeline.get());
+		if (_settings.record_threads > 0) {
+			render_info.flags = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers;
+			buffer.beginRendering(&render_info);
+			record_secondary_draws(_settings.record_threads);
+			auto secondaries = ArenaVector<vk::CommandBuffer>{
+					ArenaAllocator<vk::CommandBuffer>{*cull.arena}};
+			secondaries.reserve(_settings.record_threads);
+			for (auto i = uint32_t{}; i < _settings.record_threads; ++i) {
+				secondaries.push_back(_secondary_buffers[i].get());
+			}
+			buffer.executeCommands(secondaries);
+		} else {
+			buffer.beginRendering(&render_info);
+			record_draws(buffer, 0, cull);
+		}
+		if (_settings.occlusion_culling) {
+			// Draw whatever the early pass missed but the Hi-Z built from its depth
+			// cannot rule out, on top of what is already there.
+			buffer.endRendering();
+			record_occlusion_culling(buffer, cull);
+			color_attachment.loadOp = vk::AttachmentLoadOp::eLoad;
+			depth_attachment.loadOp = vk::AttachmentLoadOp::eLoad;
+			depth_attachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+			buffer.beginRendering(&render_info);
+			record_draws(buffer, 1, cull);
+		}
+		buffer.endRendering();
+		buffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eColorAttachmentOutput,
+				vk::PipelineStageFlagBits::eBottomOfPipe,
+				vk::DependencyFlags{},
+				VK_NULL_HANDLE,
+				VK_NULL_HANDLE,
+				color_present_barrier);
+		if (_timestamp_pool) {
+			buffer.writeTimestamp(
+					vk::PipelineStageFlagBits::eBottomOfPipe,
+					_timestamp_pool.get(),
+					graphics_timestamps + 1);
+		}
+		check(buffer.end(), "Failed to record a command buffer.");
+	}
+
+	[[nodiscard]] auto first_cull_phase() const -> CullPhase
+	{
+		return _settings.occlusion_culling ? CullPhase::early : CullPhase::frustum;
+	}
+
+	// Culling reads nothing but the uniforms, objects and the visibility its
+	// copy last recorded, so the same commands serve every frame using that
+	// copy. Each copy times its culling with a pair of queries of its own.
+	auto record_compute_commands() -> void
+	{
+		auto begin_info = vk::CommandBufferBeginInfo{
+				.pInheritanceInfo = VK_NULL_HANDLE,
+		};
+		for (auto i = uint32_t{}; i < _cull_frames.size(); ++i) {
+			auto const& frame = _cull_frames[i];
+			auto buffer = frame.compute_buffer.get();
+			check(buffer.begin(begin_info));
+			if (_timestamp_pool) {
+				buffer.resetQueryPool(_timestamp_pool.get(), 2 * i, 2);
+				buffer.writeTimestamp(
+						vk::PipelineStageFlagBits::eTopOfPipe,
+						_timestamp_pool.get(),
+						2 * i);
+			}
+			record_culling(buffer, first_cull_phase(), frame);
+			if (_timestamp_pool) {
+				buffer.writeTimestamp(
+						vk::PipelineStageFlagBits::eBottomOfPipe,
+						_timestamp_pool.get(),
+						2 * i + 1);
+			}
+			check(buffer.end(), "Failed to record a command buffer.");
+		}
+	}
+
+	// Culls the next frame's objects into its copy of the culling resources on
+	// the compute queue, once the last frame drawing from that copy has
+	// finished. The frame before it may still be drawing from the other copy.
+	auto submit_culling() -> void
+	{
+		auto& frame = _cull_frames[_cull_frame];
+		frame.compute_value = ++_compute_timeline.reserved;
+		auto wait_stage =
+				vk::PipelineStageFlags{vk::PipelineStageFlagBits::eTransfer |
+															 vk::PipelineStageFlagBits::eComputeShader};
+		auto timeline_si = vk::TimelineSemaphoreSubmitInfo{
+				.waitSemaphoreValueCount = 1,
+				.pWaitSemaphoreValues = &frame.frame_value,
+				.signalSemaphoreValueCount = 1,
+				.pSignalSemaphoreValues = &frame.compute_value,
+		};
+		auto submit_info = vk::SubmitInfo{
+				.pNext = &timeline_si,
+				.waitSemaphoreCount = 1,
+				.pWaitSemaphores = &_graphics_timeline.semaphore.get(),
+				.pWaitDstStageMask = &wait_stage,
+				.commandBufferCount = 1,
+				.pCommandBuffers = &frame.compute_buffer.get(),
+				.signalSemaphoreCount = 1,
+				.pSignalSemaphores = &_compute_timeline.semaphore.get(),
+		};
+		check(
+				_compute_queue.submit(1, &submit_info, VK_NULL_HANDLE),
+				"Failed to submit culling.");
+		_culling_submitted = true;
+	}
+
+	// Blocks until the compute queue has finished the culling that signals
+	// `value`.
+	auto wait_for_compute(uint64_t value) -> void
+	{
+		auto wait_info = vk::SemaphoreWaitInfo{
+				.semaphoreCount = 1,
+				.pSemaphores = &_compute_timeline.semaphore.get(),
+				.pValues = &value,
+		};
+		check(
+				_device->waitSemaphores(wait_info, UINT64_MAX),
+				"Failed to wait for the compute queue.");
+	}
+
+	// Timestamps only compare across queues if both families write them and
+	// the device promises a shared time base.
+	// Each copy of the culling resources has a pair of queries timing culling
+	// on the compute queue, followed by the pair timing the graphics work of a
+	// frame. Only async compute, the pipeline benchmark and hot reload use
+	// them.
+	auto create_timestamp_queries() -> void
+	{
+		if (!_settings.async_compute && !_settings.benchmark_pipelines &&
+				!_settings.hot_reload) {
+			return;
+		}
+		auto const& families = _device_info.queue_families;
+		auto const& properties = _device_info.properties;
+		if (properties.limits.timestampComputeAndGraphics == VK_FALSE ||
+				families[_queue_familes.graphics_family.value()].timestampValidBits ==
+						0 ||
+				(_settings.async_compute &&
+				 families[_queue_familes.compute_family.value()].timestampValidBits ==
+						 0)) {
+			print(stderr, "WARNING: Timestamps are unavailable on the queues\n");
+			return;
+		}
+		_timestamp_period = properties.limits.timestampPeriod;
+		auto pool_ci = vk::QueryPoolCreateInfo{
+				.queryType = vk::QueryType::eTimestamp,
+				.queryCount = graphics_timestamps + 2,
+		};
+		_timestamp_pool = check(
+				_device->createQueryPoolUnique(pool_ci),
+				"Failed to create a query pool.");
+	}
+
+	// Accumulates the last frame's culling and rendering times, and how long
+	// its culling overlapped the frame before it on the graphics queue.
+	auto read_timestamps() -> void
+	{
+		// Nothing has reset the queries before the first frame.
+		if (!_timestamp_pool || _frame_value == 0) {
+			return;
+		}
+		auto read = [this](uint32_t first, span<uint64_t, 2> stamps) {
+			return _device->getQueryPoolResults(
+								 _timestamp_pool.get(),
+								 first,
+								 stamps.size(),
+								 stamps.size_bytes(),
+								 stamps.data(),
+								 sizeof(stamps[0]),
+								 vk::QueryResultFlagBits::e64) == vk::Result::eSuccess;
+		};
+		auto render = array<uint64_t, 2>{};
+		if (!read(graphics_timestamps, render)) {
+			return;
+		}
+		auto milliseconds = [this](uint64_t begin, uint64_t end) {
+			return end > begin
+					? static_cast<double>(end - begin) * _timestamp_period * 1e-6
+					: 0.0;
+		};
+		_graphics_time += milliseconds(render[0], render[1]);
+		// Without async compute, the culling queries are never written.
+		auto cull = array<uint64_t, 2>{};
+		if (_settings.async_compute &&
+				read(2 * static_cast<uint32_t>(_last_cull_frame), cull)) {
+			_compute_time += milliseconds(cull[0], cull[1]);
+			_overlap_time += milliseconds(
+					std::max(cull[0], _previous_render[0]),
+					std::min(cull[1], _previous_render[1]));
+		}
+		_previous_render = render;
+	}
+
+	// Draws the objects, either all of them or those in indirect draw list
+	// `list` when culling is enabled.
+	auto record_draws(
+			vk::CommandBuffer const& buffer,
+			uint32_t list,
+			CullFrame const& cull) -> void
+	{
+		bind_draw_state(buffer);
+		if (_settings.culling != CullingMode::none) {
+			buffer.drawIndexedIndirectCount(
+					cull.draw_buffer.buffer.get(),
+					sizeof(vk::DrawIndexedIndirectCommand) * _objects.size() * list,
+					cull.draw_count_buffer.buffer.get(),
+					sizeof(uint32_t) * list,
+					_objects.size(),
+					sizeof(vk::DrawIndexedIndirectCommand));
+		} else {
+			buffer.drawIndexed(_indices.size(), _objects.size(), 0, 0, 0);
+		}
+	}
+
+	// Splits the visible objects across `thread_count` jobs, each recording
+	// one direct draw per object into its own secondary command buffer. The
+	// first `thread_count` secondary buffers are left ready for execution
+	// inside a render pass instance using the swapchain and depth formats.
+	auto record_secondary_draws(uint32_t thread_count) -> void
+	{
+		auto start = std::chrono::steady_clock::now();
+		auto depth_format = find_depth_format();
+		auto inheritance = vk::StructureChain{
+				vk::CommandBufferInheritanceInfo{
+						.renderPass = VK_NULL_HANDLE,
+						.subpass = 0,
+						.framebuffer = VK_NULL_HANDLE,
+						.occlusionQueryEnable = VK_FALSE,
+						.queryFlags = {},
+						.pipelineStatistics = {},
+				},
+				vk::CommandBufferInheritanceRenderingInfo{
+						.flags = {},
+						.viewMask = 0,
+						.colorAttachmentCount = 1,
+						.pColorAttachmentFormats = &_swapchain_image_format,
+						.depthAttachmentFormat = depth_format,
+						.stencilAttachmentFormat = vk::Format::eUndefined,
+						.rasterizationSamples = vk::SampleCountFlagBits::e1,
+				},
+		};
+		auto draws = span(_visible).first(_visible_count);
+		auto chunk = (draws.size() + thread_count - 1) / thread_count;
+		auto record = [&](uint32_t thread) {
+			auto begin = std::min(draws.size(), chunk * thread);
+			auto end = std::min(draws.size(), begin + chunk);
+			record_secondary(
+					thread,
+					inheritance.get<vk::CommandBufferInheritanceInfo>(),
+					draws.subspan(begin, end - begin));
+		};
+		auto counter = JobCounter{};
+		for (auto i = uint32_t{1}; i < thread_count; ++i) {
+			_jobs.run(counter, [&record, i] { record(i); });
+		}
+		record(0);
+		_jobs.wait(counter);
+		_record_time += std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start)
+												.count();
+	}
+
+	auto record_secondary(
+			uint32_t thread,
+			vk::CommandBufferInheritanceInfo const& inheritance,
+			span<uint32_t const> objects) -> void
+	{
+		check(_device->resetCommandPool(_record_pools[thread].get()));
+		auto buffer = _secondary_buffers[thread].get();
+		auto begin_info = vk::CommandBufferBeginInfo{
+				.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+						vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+				.pInheritanceInfo = &inheritance,
+		};
+		check(
+				buffer.begin(begin_info),
+				"Failed to begin recording a command buffer.");
+		bind_draw_state(buffer);
+		for (auto object : objects) {
+			buffer.drawIndexed(_indices.size(), 1, 0, 0, object);
+		}
+		check(buffer.end(), "Failed to record a command buffer.");
+	}
+
+	// Records every thread count from one up to the number of recording pools
+	// without submitting anything, to compare the CPU cost of recording.
+	auto benchmark_recording() -> void
+	{
+		if (_settings.culling == CullingMode::cpu) {
+			update_uniform(simulate());
+			cull_objects();
+		}
+		auto iterations = 100;
+		print("Recording {} draws:\n", _visible_count);
+		for (auto threads = uint32_t{1}; threads <= _record_pools.size();
+				 ++threads) {
+			_record_time = 0;
+			for (auto i = 0; i < iterations; ++i) {
+				record_secondary_draws(threads);
+			}
+			print(
+					"{:3} threads: {:8.3f} ms\n",
+					threads,
+					1000.0 * _record_time / iterations);
+		}
+		_record_time = 0;
+	}
+
+	// Draws frames into a hidden window and fails if the thread drawing them
+	// allocates from the heap once the warm-up frames have grown every pool and
+	// cache. Allocations by other threads, such as the driver's, are reported
+	// but do not fail the run.
+	auto benchmark_allocations() -> bool
+	{
+		auto const warm_up_frames = 100;
+		auto const measured_frames = 1000;
+		// Pipelines still compiling would be swapped in during the measured
+		// frames and rerecord the command buffers.
+		while (!_pending_pipelines.empty() || !_pending_shaders.empty()) {
+			reload_shaders();
+			collect_pipelines();
+			std::this_thread::yield();
+		}
+		_start_time = glfwGetTime();
+		for (auto i = 0; i < warm_up_frames; ++i) {
+			glfwPollEvents();
+			auto snapshot = simulate();
+			draw_frame(snapshot);
+		}
+		auto phases = array<AllocationStats, allocation_phase_count>{};
+		for (auto i = size_t{}; i < phases.size(); ++i) {
+			phases[i] = phase_allocations(static_cast<AllocationPhase>(i));
+		}
+		auto own = thread_allocations().count;
+		auto total = heap_allocation_count();
+		for (auto i = 0; i < measured_frames; ++i) {
+			glfwPollEvents();
+			auto snapshot = simulate();
+			draw_frame(snapshot);
+		}
+		// Taken before waiting for the device, which may allocate itself.
+		for (auto i = size_t{}; i < phases.size(); ++i) {
+			auto after = phase_allocations(static_cast<AllocationPhase>(i));
+			phases[i].count = after.count - phases[i].count;
+			phases[i].bytes = after.bytes - phases[i].bytes;
+		}
+		own = thread_allocations().count - own;
+		total = heap_allocation_count() - total;
+		check(_device->waitIdle());
+		print("Heap allocations over {} frames:\n", measured_frames);
+		for (auto i = size_t{}; i < phases.size(); ++i) {
+			print(
+					"{:>8}: {:6} allocations, {:9} bytes\n",
+					allocation_phase_name(static_cast<AllocationPhase>(i)),
+					phases[i].count,
+					phases[i].bytes);
+		}
+		print(
+				"{:>8}: {:6} allocations on this thread, {} on others\n",
+				"threads",
+				own,
+				total - own);
+		if (own > 0) {
+			print(stderr, "FATAL: The frame loop allocated after warm-up.\n");
+			return false;
+		}
+		return true;
+	}
+
+	// Rewrites a growing number of entries of the bindless texture table per
+	// frame, without drawing, to compare the CPU cost of updating the scene's
+	// descriptor set with writing the same descriptors into a mapped
+	// descriptor buffer.
+	auto benchmark_descriptors() -> void
+	{
+		auto const frames = 100;
+		auto const counts = array<uint32_t, 4>{16, 256, 4096, 16384};
+		auto texture = _bindless_textures.front();
+		auto writes = vector<vk::WriteDescriptorSet>{};
+		writes.reserve(_texture_capacity);
+		auto update_sets = [&](uint32_t count) {
+			writes.clear();
+			for (auto i = uint32_t{}; i < count; ++i) {
+				writes.push_back(vk::WriteDescriptorSet{
+						.dstSet = _descriptor_set,
+						.dstBinding = 2,
+						.dstArrayElement = i,
+						.descriptorCount = 1,
+						.descriptorType = vk::DescriptorType::eCombinedImageSampler,
+						.pImageInfo = &texture,
+						.pBufferInfo = VK_NULL_HANDLE,
+						.pTexelBufferView = VK_NULL_HANDLE,
+				});
+			}
+			_device->updateDescriptorSets(writes, VK_NULL_HANDLE);
+		};
+		// A table of the same shape as the scene's, in a descriptor buffer.
+		auto layout = vk::UniqueDescriptorSetLayout{};
+		auto table = BufferMemory{};
+		auto* table_data = static_cast<std::byte*>(nullptr);
+		auto table_offset = vk::DeviceSize{};
+		if (_descriptor_buffer_supported) {
+			auto binding = vk::DescriptorSetLayoutBinding{
+					.binding = 0,
+					.descriptorType = vk::DescriptorType::eCombinedImageSampler,
+					.descriptorCount = _texture_capacity,
+					.stageFlags = vk::ShaderStageFlagBits::eFragment,
+					.pImmutableSamplers = VK_NULL_HANDLE,
+			};
+			layout = check(
+					_device->createDescriptorSetLayoutUnique(
+							vk::DescriptorSetLayoutCreateInfo{
+									.flags = vk::DescriptorSetLayoutCreateFlagBits::
+											eDescriptorBufferEXT,
+									.bindingCount = 1,
+									.pBindings = &binding,
+							}),
+					"Failed to create a descriptor set layout.");
+			auto size = _device->getDescriptorSetLayoutSizeEXT(layout.get());
+			table_offset =
+					_device->getDescriptorSetLayoutBindingOffsetEXT(layout.get(), 0);
+			table = create_buffer(
+					size,
+					descriptor_buffer_usage,
+					vk::MemoryPropertyFlagBits::eHostVisible |
+							vk::MemoryPropertyFlagBits::eHostCoherent);
+			auto* data = static_cast<void*>(nullptr);
+			check(_device->mapMemory(
+					table.memory.get(),
+					0,
+					size,
+					vk::MemoryMapFlags{},
+					&data));
+			table_data = static_cast<std::byte*>(data) + table_offset;
+		}
+		auto write_buffer = [&](uint32_t count) {
+			auto data = vk::DescriptorDataEXT{};
+			data.pCombinedImageSampler = &texture;
+			auto size = _device_info.descriptor_buffer_properties
+											.combinedImageSamplerDescriptorSize;
+			for (auto i = uint32_t{}; i < count; ++i) {
+				write_descriptor(
+						vk::DescriptorType::eCombinedImageSampler,
+						data,
+						size,
+						table_data + i * size);
+			}
+		};
+		auto time = [&](auto const& update, uint32_t count) {
+			auto start = glfwGetTime();
+			for (auto i = 0; i < frames; ++i) {
+				update(count);
+			}
+			return 1e6 * (glfwGetTime() - start) / frames;
+		};
+		print("Descriptor writes per frame, in microseconds:\n");
+		for (auto count : counts) {
+			if (count > _texture_capacity) {
+				break;
+			}
+			auto sets = time(update_sets, count);
+			if (!_descriptor_buffer_supported) {
+				print("{:6}: sets {:10.3f}\n", count, sets);
+				continue;
+			}
+			auto buffer = time(write_buffer, count);
+			print(
+					"{:6}: sets {:10.3f}, descriptor buffer {:10.3f} ({:.2f}x)\n",
+					count,
+					sets,
+					buffer,
+					sets / buffer);
+		}
+	}
+
+	// Times how long new pipeline variants take to become usable when compiled
+	// whole and when linked from libraries, then draws with the scene pipeline
+	// built each way to compare their cost.
+	auto benchmark_pipelines() -> void
+	{
+		auto const variants = 8;
+		auto const frames = 200;
+		while (!_pending_pipelines.empty()) {
+			collect_pipelines();
+			std::this_thread::yield();
+		}
+		// Each variant has its own alpha cutoff, so neither the pipeline cache
+		// nor an earlier library holds its fragment shader.
+		auto variant = [this](int set, int index) {
+			auto desc = _scene_desc;
+			desc.features.alpha_test = VK_TRUE;
+			desc.features.alpha_cutoff =
+					static_cast<float>(set * variants + index + 1) / 64.0f;
+			return desc;
+		};
+		auto milliseconds = [](double start) {
+			return 1000.0 * (glfwGetTime() - start);
+		};
+		print("First use of {} new variants, per variant:\n", variants);
+		auto monolithic = 0.0;
+		for (auto i = 0; i < variants; ++i) {
+			auto start = glfwGetTime();
+			auto pipeline = create_graphics_pipeline(variant(0, i));
+			monolithic += milliseconds(start);
+		}
+		print("{:>16}: {:8.3f} ms\n", "monolithic", monolithic / variants);
+		if (_settings.pipeline_library) {
+			auto libraries = 0.0;
+			auto fast_link = 0.0;
+			auto optimized_link = 0.0;
+			for (auto i = 0; i < variants; ++i) {
+				auto start = glfwGetTime();
+				auto parts = create_libraries(variant(1, i));
+				libraries += milliseconds(start);
+				start = glfwGetTime();
+				auto fast = link_pipeline(parts, false);
+				fast_link += milliseconds(start);
+				start = glfwGetTime();
+				auto optimized = link_pipeline(parts, true);
+				optimized_link += milliseconds(start);
+			}
+			print("{:>16}: {:8.3f} ms\n", "new libraries", libraries / variants);
+			print("{:>16}: {:8.3f} ms\n", "fast link", fast_link / variants);
+			print(
+					"{:>16}: {:8.3f} ms\n",
+					"optimized link",
+					optimized_link / variants);
+		}
+
+		auto candidates = vector<std::pair<char const*, vk::UniquePipeline>>{};
+		candidates.emplace_back(
+				"monolithic",
+				create_graphics_pipeline(_scene_desc));
+		if (_settings.pipeline_library) {
+			auto parts = create_libraries(_scene_desc);
+			candidates.emplace_back("fast link", link_pipeline(parts, false));
+			candidates.emplace_back("optimized link", link_pipeline(parts, true));
+		}
+		print("Drawing {} frames, per frame:\n", frames);
+		_start_time = glfwGetTime();
+		for (auto& [name, pipeline] : candidates) {
+			wait_for_frame();
+			std::swap(_pipelines[_scene_desc], pipeline);
+			_commands_dirty = true;
+			auto snapshot = simulate();
+			draw_frame(snapshot);
+			_graphics_time = 0;
+			auto start = glfwGetTime();
+			for (auto i = 0; i < frames; ++i) {
+				glfwPollEvents();
+				snapshot = simulate();
+				draw_frame(snapshot);
+			}
+			wait_for_frame();
+			auto frame_time = milliseconds(start) / frames;
+			if (_timestamp_pool) {
+				print(
+						"{:>16}: {:8.3f} ms, {:.3f} ms on the GPU\n",
+						name,
+						frame_time,
+						_graphics_time / frames);
+			} else {
+				print("{:>16}: {:8.3f} ms\n", name, frame_time);
+			}
+			std::swap(_pipelines[_scene_desc], pipeline);
+		}
+		_commands_dirty = true;
+		check(_device->waitIdle());
+		print_pipeline_stats();
+	}
+
+	auto bind_draw_state(vk::CommandBuffer const& buffer) -> void
+	{
+		auto viewport = vk::Viewport{
+				.x = 0,
+				.y = 0,
+				.width = static_cast<float>(_swapchain_extent.width),
+				.height = static_cast<float>(_swapchain_extent.height),
+				.minDepth = 0,
+				.maxDepth = 1,
+		};
+		auto scissor = vk::Rect2D{
+				.offset =
+						vk::Offset2D{
+								.x = 0,
+								.y = 0,
+						},
+				.extent = _swapchain_extent,
+		};
+		buffer.setViewport(0, viewport);
+		buffer.setScissor(0, scissor);
+		buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, _scene_pipeline);
 		buffer.bindVertexBuffers(0, _vertex_buffer.buffer.get(), 0ul);
 		buffer.bindIndexBuffer(
 				_index_buffer.buffer.get(),
 				0,
 				vk::IndexType::eUint32);
-		buffer.bindDescriptorSets(
-				vk::PipelineBindPoint::eGraphics,
+		if (_settings.descriptor_buffer) {
+			auto binding = vk::DescriptorBufferBindingInfoEXT{
+					.address = _descriptor_ring_address,
+					.usage = descriptor_buffer_usage,
+			};
+			auto index = uint32_t{0};
+			auto offset = _descriptor_slot * _descriptor_set_size;
+			buffer.bindDescriptorBuffersEXT(binding);
+			buffer.setDescriptorBufferOffsetsEXT(
+					vk::PipelineBindPoint::eGraphics,
+					_pipeline_layout.get(),
+					0,
+					index,
+					offset);
+		} else {
+			buffer.bindDescriptorSets(
+					vk::PipelineBindPoint::eGraphics,
+					_pipeline_layout.get(),
+					0,
+					_descriptor_set,
+					VK_NULL_HANDLE);
+		}
+		auto constants = DrawConstants{
+				.model = _model,
+				.objects = _object_buffer_index,
+		};
+		buffer.pushConstants(
 				_pipeline_layout.get(),
+				vk::ShaderStageFlagBits::eVertex,
 				0,
-				_descriptor_set,
+				sizeof(constants),
+				&constants);
+	}
+
+	// Writes one indirect draw per object that survives culling, and the
+	// number of such draws, for drawIndexedIndirectCount to consume. The late
+	// phase appends to the second draw list.
+	auto record_culling(
+			vk::CommandBuffer const& buffer,
+			CullPhase phase,
+			CullFrame const& cull) -> void
+	{
+		if (phase != CullPhase::late) {
+			buffer.fillBuffer(
+					cull.draw_count_buffer.buffer.get(),
+					0,
+					VK_WHOLE_SIZE,
+					0);
+			if (_settings.occlusion_culling) {
+				buffer.fillBuffer(
+						cull.statistics_buffer.buffer.get(),
+						0,
+						VK_WHOLE_SIZE,
+						0);
+			}
+			auto clear_barrier = vk::MemoryBarrier{
+					.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+					.dstAccessMask =
+							vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+			};
+			buffer.pipelineBarrier(
+					vk::PipelineStageFlagBits::eTransfer,
+					vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags{},
+					clear_barrier,
+					VK_NULL_HANDLE,
+					VK_NULL_HANDLE);
+		}
+		auto constants = CullConstants{
+				.model = _model,
+				.object_count = static_cast<uint32_t>(_objects.size()),
+				.index_count = static_cast<uint32_t>(_indices.size()),
+				.phase = phase,
+		};
+		buffer.bindPipeline(vk::PipelineBindPoint::eCompute, _cull_pipeline.get());
+		buffer.bindDescriptorSets(
+				vk::PipelineBindPoint::eCompute,
+				_cull_pipeline_layout.get(),
+				0,
+				cull.descriptor_set,
 				VK_NULL_HANDLE);
-		buffer.drawIndexed(_indices.size(), 1, 0, 0, 0);
-		buffer.endRendering();
+		buffer.pushConstants(
+				_cull_pipeline_layout.get(),
+				vk::ShaderStageFlagBits::eCompute,
+				0,
+				sizeof(constants),
+				&constants);
+		buffer.dispatch(
+				(constants.object_count + cull_group_size - 1) / cull_group_size,
+				1,
+				1);
+	}
+
+	// A frame does not wait for earlier submissions to the graphics queue, so
+	// this orders it after their copies, which may have filled buffers and
+	// images it reads, and after the previous frame's culling and draws, which
+	// used the draw lists it is about to overwrite.
+	auto record_frame_barrier(vk::CommandBuffer const& buffer) -> void
+	{
+		auto frame_barrier = vk::MemoryBarrier{
+				.srcAccessMask = vk::AccessFlagBits::eTransferWrite |
+						vk::AccessFlagBits::eShaderWrite,
+				.dstAccessMask = vk::AccessFlagBits::eTransferWrite |
+						vk::AccessFlagBits::eIndirectCommandRead |
+						vk::AccessFlagBits::eIndexRead |
+						vk::AccessFlagBits::eVertexAttributeRead |
+						vk::AccessFlagBits::eUniformRead | vk::AccessFlagBits::eShaderRead |
+						vk::AccessFlagBits::eShaderWrite,
+		};
 		buffer.pipelineBarrier(
-				vk::PipelineStageFlagBits::eColorAttachmentOutput,
-				vk::PipelineStageFlagBits::eBottomOfPipe,
+				vk::PipelineStageFlagBits::eTransfer |
+						vk::PipelineStageFlagBits::eComputeShader |
+						vk::PipelineStageFlagBits::eDrawIndirect,
+				vk::PipelineStageFlagBits::eTransfer |
+						vk::PipelineStageFlagBits::eDrawIndirect |
+						vk::PipelineStageFlagBits::eVertexInput |
+						vk::PipelineStageFlagBits::eVertexShader |
+						vk::PipelineStageFlagBits::eFragmentShader |
+						vk::PipelineStageFlagBits::eComputeShader,
 				vk::DependencyFlags{},
+				frame_barrier,
 				VK_NULL_HANDLE,
+				VK_NULL_HANDLE);
+	}
+
+	// Makes the draw lists written by culling on the graphics queue available
+	// to the indirect draws that follow.
+	auto record_draw_barrier(vk::CommandBuffer const& buffer) -> void
+	{
+		auto draw_barrier = vk::MemoryBarrier{
+				.srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+				.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead,
+		};
+		buffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eComputeShader,
+				vk::PipelineStageFlagBits::eDrawIndirect,
+				vk::DependencyFlags{},
+				draw_barrier,
 				VK_NULL_HANDLE,
-				color_present_barrier);
-		check(buffer.end(), "Failed to record a command buffer.");
+				VK_NULL_HANDLE);
+	}
+
+	// Reduces the early pass's depth into the Hi-Z pyramid, then runs the late
+	// culling phase against it. Leaves the depth image ready to be drawn to.
+	auto record_occlusion_culling(
+			vk::CommandBuffer const& buffer,
+			CullFrame const& cull) -> void
+	{
+		auto depth_range = vk::ImageSubresourceRange{
+				.aspectMask = vk::ImageAspectFlagBits::eDepth,
+				.baseMipLevel = 0,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+		};
+		auto levels = static_cast<uint32_t>(_hiz_level_views.size());
+		auto read_barriers = array<vk::ImageMemoryBarrier, 2>{
+				vk::ImageMemoryBarrier{
+						.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+						.dstAccessMask = vk::AccessFlagBits::eShaderRead,
+						.oldLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+						.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+						.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+						.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+						.image = _depth_image.image.get(),
+						.subresourceRange = depth_range,
+				},
+				vk::ImageMemoryBarrier{
+						.srcAccessMask = vk::AccessFlagBits::eNone,
+						.dstAccessMask = vk::AccessFlagBits::eShaderWrite,
+						.oldLayout = vk::ImageLayout::eUndefined,
+						.newLayout = vk::ImageLayout::eGeneral,
+						.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+						.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+						.image = _hiz_image.image.get(),
+						.subresourceRange =
+								vk::ImageSubresourceRange{
+										.aspectMask = vk::ImageAspectFlagBits::eColor,
+										.baseMipLevel = 0,
+										.levelCount = levels,
+										.baseArrayLayer = 0,
+										.layerCount = 1,
+								},
+				},
+		};
+		buffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eLateFragmentTests |
+						vk::PipelineStageFlagBits::eComputeShader,
+				vk::PipelineStageFlagBits::eComputeShader,
+				vk::DependencyFlags{},
+				VK_NULL_HANDLE,
+				VK_NULL_HANDLE,
+				read_barriers);
+		buffer.bindPipeline(vk::PipelineBindPoint::eCompute, _hiz_pipeline.get());
+		auto level_barrier = vk::MemoryBarrier{
+				.srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+				.dstAccessMask = vk::AccessFlagBits::eShaderRead,
+		};
+		for (auto level = uint32_t{}; level < levels; ++level) {
+			auto constants = HizConstants{
+					.width = std::max(_swapchain_extent.width >> level, 1u),
+					.height = std::max(_swapchain_extent.height >> level, 1u),
+					.scale = level == 0 ? 1u : 2u,
+			};
+			buffer.bindDescriptorSets(
+					vk::PipelineBindPoint::eCompute,
+					_hiz_pipeline_layout.get(),
+					0,
+					_hiz_descriptor_sets[level],
+					VK_NULL_HANDLE);
+			buffer.pushConstants(
+					_hiz_pipeline_layout.get(),
+					vk::ShaderStageFlagBits::eCompute,
+					0,
+					sizeof(constants),
+					&constants);
+			buffer.dispatch(
+					(constants.width + hiz_group_size - 1) / hiz_group_size,
+					(constants.height + hiz_group_size - 1) / hiz_group_size,
+					1);
+			buffer.pipelineBarrier(
+					vk::PipelineStageFlagBits::eComputeShader,
+					vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags{},
+					level_barrier,
+					VK_NULL_HANDLE,
+					VK_NULL_HANDLE);
+		}
+		record_culling(buffer, CullPhase::late, cull);
+		record_draw_barrier(buffer);
+		auto write_barrier = vk::ImageMemoryBarrier{
+				.srcAccessMask = vk::AccessFlagBits::eNone,
+				.dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead |
+						vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+				.oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+				.newLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = _depth_image.image.get(),
+				.subresourceRange = depth_range,
+		};
+		buffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eComputeShader,
+				vk::PipelineStageFlagBits::eEarlyFragmentTests |
+						vk::PipelineStageFlagBits::eLateFragmentTests,
+				vk::DependencyFlags{},
+				VK_NULL_HANDLE,
+				VK_NULL_HANDLE,
+				write_barrier);
 	}
 };
 
+// Parses the value of a `--name=value` style numeric option.
+auto parse_option(char const* arg, std::string_view name) -> optional<uint32_t>
+{
+	auto option = std::string_view{arg};
+	if (!option.starts_with(name)) {
+		return std::nullopt;
+	}
+	auto value = uint32_t{};
+	auto const* last = option.data() + option.size();
+	auto [end, error] = std::from_chars(option.data() + name.size(), last, value);
+	if (error != std::errc{} || end != last) {
+		print(stderr, "WARNING: Ignoring malformed option: {}\n", arg);
+		return std::nullopt;
+	}
+	return value;
+}
+
 auto main(int argc, char** argv) -> int
 {
 	auto args = span(argv, static_cast<size_t>(argc));
-	auto enable_layers = true;
-	auto present_mode = vk::PresentModeKHR::eFifo;
+	auto settings = Settings{
+			.job_threads = std::max(std::thread::hardware_concurrency(), 1u),
+	};
 	for (auto& arg : args) {
 		if (strcmp(arg, "--disable-layers") == 0) {
-			enable_layers = false;
+			settings.enable_layers = false;
 		}
 		if (strcmp(arg, "--mailbox") == 0) {
-			present_mode = vk::PresentModeKHR::eMailbox;
+			settings.present_mode = vk::PresentModeKHR::eMailbox;
+		}
+		if (strcmp(arg, "--cpu-culling") == 0) {
+			settings.culling = CullingMode::cpu;
+		}
+		if (strcmp(arg, "--gpu-culling") == 0) {
+			settings.culling = CullingMode::gpu;
+		}
+		if (strcmp(arg, "--occlusion-culling") == 0) {
+			settings.culling = CullingMode::gpu;
+			settings.occlusion_culling = true;
+		}
+		if (strcmp(arg, "--async-compute") == 0) {
+			settings.async_compute = true;
+		}
+		if (strcmp(arg, "--render-thread") == 0) {
+			settings.render_thread = true;
+		}
+		if (strcmp(arg, "--submit-thread") == 0) {
+			settings.render_thread = true;
+			settings.submit_thread = true;
+		}
+		if (strcmp(arg, "--huge-pages") == 0) {
+			settings.huge_pages = true;
+		}
+		if (strcmp(arg, "--present-wait") == 0) {
+			settings.present_wait = true;
+		}
+		if (auto fps = parse_option(arg, "--fps="); fps.has_value()) {
+			settings.target_fps = fps.value();
+		}
+		if (strcmp(arg, "--late-latch") == 0) {
+			settings.late_latch = true;
+		}
+		if (strcmp(arg, "--on-demand") == 0) {
+			settings.on_demand = true;
+		}
+		if (strcmp(arg, "--prerecord") == 0) {
+			settings.prerecord = true;
+		}
+		if (auto threads = parse_option(arg, "--record-threads=");
+				threads.has_value()) {
+			settings.record_threads = threads.value();
+		}
+		if (strcmp(arg, "--bench-recording") == 0) {
+			settings.benchmark_recording = true;
+		}
+		if (auto threads = parse_option(arg, "--job-threads=");
+				threads.has_value()) {
+			settings.job_threads = std::max(threads.value(), uint32_t{1});
+		}
+		if (strcmp(arg, "--bench-allocations") == 0) {
+			settings.benchmark_allocations = true;
+		}
+		if (strcmp(arg, "--report-allocations") == 0) {
+			settings.report_allocations = true;
+		}
+		if (strcmp(arg, "--monolithic-pipelines") == 0) {
+			settings.pipeline_library = false;
+		}
+		if (strcmp(arg, "--bench-pipelines") == 0) {
+			settings.benchmark_pipelines = true;
+		}
+		if (strcmp(arg, "--hot-reload") == 0) {
+			settings.hot_reload = true;
+		}
+		if (strcmp(arg, "--descriptor-buffer") == 0) {
+			settings.descriptor_buffer = true;
+		}
+		if (strcmp(arg, "--bench-descriptors") == 0) {
+			settings.benchmark_descriptors = true;
+		}
+		if (strcmp(arg, "--bench-jobs") == 0) {
+			benchmark_jobs();
+			return EXIT_SUCCESS;
+		}
+		if (strcmp(arg, "--bench-culling") == 0) {
+			benchmark_culling();
+			return EXIT_SUCCESS;
+		}
+		if (auto count = parse_option(arg, "--objects="); count.has_value()) {
+			settings.object_count = std::max(count.value(), uint32_t{1});
+		}
+	}
+	if (settings.culling != CullingMode::gpu) {
+		settings.occlusion_culling = false;
+		settings.async_compute = false;
+	}
+	// The descriptor benchmark updates the scene's descriptor set directly.
+	if (settings.benchmark_descriptors) {
+		settings.descriptor_buffer = false;
+	}
+	if (settings.benchmark_recording && settings.record_threads == 0) {
+		settings.record_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	// Secondary command buffers hold direct draws for the objects visible this
+	// frame, so they are re-recorded every frame and need the CPU's draw list.
+	if (settings.record_threads > 0 &&
+			(settings.culling == CullingMode::gpu || settings.prerecord)) {
+		print(
+				stderr,
+				"WARNING: Parallel recording is unavailable with GPU culling or "
+				"pre-recorded command buffers.\n");
+		settings.record_threads = 0;
+		settings.benchmark_recording = false;
+	}
+	// A hidden window may never be shown, so do not let presentation wait on
+	// vertical blanks. Frames are drawn on the main thread.
+	if (settings.benchmark_allocations || settings.benchmark_pipelines) {
+		if (settings.present_mode == vk::PresentModeKHR::eFifo) {
+			settings.present_mode = vk::PresentModeKHR::eImmediate;
 		}
+		settings.render_thread = false;
+		settings.submit_thread = false;
 	}
-	auto app = Application{enable_layers, present_mode};
-	app.run();
-	return EXIT_SUCCESS;
+	auto app = Application{settings};
+	return app.run() ? EXIT_SUCCESS : EXIT_FAILURE;
 }
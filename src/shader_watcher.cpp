@@ -0,0 +1,131 @@
+#include "shader_watcher.hpp"
+
+#include <fmt/core.h>
+
+#ifdef __linux__
+#include <spawn.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <system_error>
+#include <utility>
+
+#ifdef __linux__
+extern char** environ;  // NOLINT(readability-redundant-declaration)
+#endif
+
+using fmt::print;
+
+ShaderWatcher::ShaderWatcher(
+		std::filesystem::path source_dir,
+		std::filesystem::path output_dir)
+		: _source_dir{std::move(source_dir)}, _output_dir{std::move(output_dir)}
+{
+#ifdef __linux__
+	_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	// Editors that save by renaming a temporary file over the source only
+	// produce IN_MOVED_TO.
+	if (_inotify < 0 ||
+			inotify_add_watch(
+					_inotify,
+					_source_dir.c_str(),
+					IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		print(
+				stderr,
+				"WARNING: Cannot watch {} for shader changes\n",
+				_source_dir.string());
+	}
+#else
+	print(stderr, "WARNING: Shader hot reload needs inotify\n");
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+#ifdef __linux__
+	if (_inotify >= 0) {
+		close(_inotify);
+	}
+#endif
+}
+
+auto ShaderWatcher::changed() -> std::vector<std::string>
+{
+	auto names = std::vector<std::string>{};
+#ifdef __linux__
+	if (_inotify < 0) {
+		return names;
+	}
+	alignas(inotify_event) auto buffer = std::array<char, 4096>{};
+	while (true) {
+		auto size = read(_inotify, buffer.data(), buffer.size());
+		if (size <= 0) {
+			break;
+		}
+		for (auto offset = ssize_t{}; offset < size;) {
+			auto const* event =
+					// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+					reinterpret_cast<inotify_event const*>(buffer.data() + offset);
+			if (event->len > 0) {
+				auto name = std::string{event->name};
+				if (std::ranges::find(names, name) == names.end()) {
+					names.push_back(std::move(name));
+				}
+			}
+			offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+		}
+	}
+#endif
+	return names;
+}
+
+auto ShaderWatcher::compile(std::string const& name) const -> bool
+{
+#ifdef __linux__
+	auto source = (_source_dir / name).string();
+	auto output = (_output_dir / (name + ".spv")).string();
+	auto temporary = output + ".tmp";
+	// posix_spawn takes the arguments as mutable strings.
+	auto program = std::string{"glslc"};
+	auto output_flag = std::string{"-o"};
+	auto arguments = std::array<char*, 5>{
+			program.data(),
+			source.data(),
+			output_flag.data(),
+			temporary.data(),
+			nullptr,
+	};
+	auto pid = pid_t{};
+	if (posix_spawnp(
+					&pid,
+					program.c_str(),
+					nullptr,
+					nullptr,
+					arguments.data(),
+					environ) != 0) {
+		print(stderr, "WARNING: Failed to run glslc\n");
+		return false;
+	}
+	auto status = 0;
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			return false;
+		}
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		return false;
+	}
+	auto error = std::error_code{};
+	std::filesystem::rename(temporary, output, error);
+	return !error;
+#else
+	static_cast<void>(name);
+	return false;
+#endif
+}
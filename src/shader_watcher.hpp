@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Watches a directory of GLSL sources and recompiles the ones that change
+// with glslc, into the SPIR-V files the program loads. Only Linux has
+// inotify; elsewhere no change is ever reported.
+class ShaderWatcher
+{
+ public:
+	ShaderWatcher(
+			std::filesystem::path source_dir,
+			std::filesystem::path output_dir);
+	~ShaderWatcher();
+
+	ShaderWatcher(ShaderWatcher const&) = delete;
+	ShaderWatcher(ShaderWatcher&&) = delete;
+	auto operator=(ShaderWatcher const&) -> ShaderWatcher& = delete;
+	auto operator=(ShaderWatcher&&) -> ShaderWatcher& = delete;
+
+	// File names of the sources written since the last call, such as
+	// "shader.frag". Never blocks.
+	auto changed() -> std::vector<std::string>;
+
+	// Compiles source `name` to `<output_dir>/<name>.spv` and returns whether
+	// glslc succeeded. Blocks until it exits, so call it off the frame loop.
+	// The output is replaced atomically, and kept as it was on failure.
+	[[nodiscard]] auto compile(std::string const& name) const -> bool;
+
+ private:
+	std::filesystem::path _source_dir;
+	std::filesystem::path _output_dir;
+	int _inotify = -1;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <optional>
+
+// Bounded lock-free queue between exactly one producer and one consumer
+// thread. Each side caches the other's index, so the shared cache lines are
+// only touched when the queue looks full or empty.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert(std::has_single_bit(Capacity));
+
+ public:
+	auto try_push(T const& value) -> bool
+	{
+		auto tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _cached_head == Capacity) {
+			_cached_head = _head.load(std::memory_order_acquire);
+			if (tail - _cached_head == Capacity) {
+				return false;
+			}
+		}
+		_slots[tail % Capacity] = value;
+		_tail.store(tail + 1, std::memory_order_release);
+		_tail.notify_one();
+		return true;
+	}
+
+	auto try_pop() -> std::optional<T>
+	{
+		auto head = _head.load(std::memory_order_relaxed);
+		if (head == _cached_tail) {
+			_cached_tail = _tail.load(std::memory_order_acquire);
+			if (head == _cached_tail) {
+				return std::nullopt;
+			}
+		}
+		auto value = _slots[head % Capacity];
+		_head.store(head + 1, std::memory_order_release);
+		return value;
+	}
+
+	// Blocks the consumer until a value arrives.
+	auto pop() -> T
+	{
+		while (true) {
+			if (auto value = try_pop(); value.has_value()) {
+				return value.value();
+			}
+			_tail.wait(_cached_tail, std::memory_order_acquire);
+		}
+	}
+
+ private:
+	// Consumer side.
+	alignas(64) std::atomic<size_t> _head{0};
+	size_t _cached_tail = 0;
+	// Producer side.
+	alignas(64) std::atomic<size_t> _tail{0};
+	size_t _cached_head = 0;
+	alignas(64) std::array<T, Capacity> _slots{};
+};
@@ -0,0 +1,400 @@
+#pragma once
+
+#include "background.hpp"
+#include "jobs.hpp"
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+class PromiseBase
+{
+ public:
+	class FinalAwaiter
+	{
+	 public:
+		[[nodiscard]] auto await_ready() const noexcept -> bool
+		{
+			return false;
+		}
+
+		template <typename Promise>
+		auto await_suspend(std::coroutine_handle<Promise> handle) noexcept
+				-> std::coroutine_handle<>
+		{
+			// Read the continuation first: once `done` is set, a task started with
+			// Task::start may be destroyed by the thread waiting for it.
+			auto continuation = handle.promise().continuation;
+			handle.promise().done.store(true, std::memory_order_release);
+			return continuation ? continuation : std::noop_coroutine();
+		}
+
+		auto await_resume() const noexcept -> void {}
+	};
+
+	auto initial_suspend() noexcept -> std::suspend_always
+	{
+		return {};
+	}
+
+	auto final_suspend() noexcept -> FinalAwaiter
+	{
+		return {};
+	}
+
+	auto unhandled_exception() -> void
+	{
+		std::terminate();
+	}
+
+	std::coroutine_handle<> continuation;
+	std::atomic<bool> done{false};
+};
+
+template <typename T>
+class Promise : public PromiseBase
+{
+ public:
+	auto get_return_object() -> Task<T>;
+
+	auto return_value(T value) -> void
+	{
+		result.emplace(std::move(value));
+	}
+
+	std::optional<T> result;
+};
+
+template <>
+class Promise<void> : public PromiseBase
+{
+ public:
+	auto get_return_object() -> Task<void>;
+
+	auto return_void() -> void {}
+};
+
+// Fire-and-forget coroutine used to observe the completion of other tasks.
+class Detached
+{
+ public:
+	class promise_type
+	{
+	 public:
+		auto get_return_object() -> Detached
+		{
+			return {};
+		}
+
+		auto initial_suspend() noexcept -> std::suspend_never
+		{
+			return {};
+		}
+
+		auto final_suspend() noexcept -> std::suspend_never
+		{
+			return {};
+		}
+
+		auto unhandled_exception() -> void
+		{
+			std::terminate();
+		}
+
+		auto return_void() -> void {}
+	};
+};
+
+}  // namespace detail
+
+// Lazily started coroutine producing a T. Awaiting a task starts it and
+// resumes the awaiting coroutine, on whichever thread finished the task, once
+// it has returned.
+template <typename T>
+class [[nodiscard]] Task
+{
+ public:
+	using promise_type = detail::Promise<T>;
+	using Handle = std::coroutine_handle<promise_type>;
+
+	explicit Task(Handle handle) : _handle{handle} {}
+
+	Task(Task&& other) noexcept : _handle{std::exchange(other._handle, {})} {}
+
+	Task(Task const&) = delete;
+	auto operator=(Task const&) -> Task& = delete;
+	auto operator=(Task&&) -> Task& = delete;
+
+	~Task()
+	{
+		if (_handle) {
+			_handle.destroy();
+		}
+	}
+
+	// Awaits completion without taking the result, for use with when_all.
+	auto completion() noexcept
+	{
+		return Awaiter<false>{_handle};
+	}
+
+	auto operator co_await() && noexcept
+	{
+		return Awaiter<true>{_handle};
+	}
+
+	// Runs the task on the calling thread until it first suspends. Only for
+	// tasks nobody awaits; poll done() to find out when it has finished.
+	auto start() -> void
+	{
+		_handle.resume();
+	}
+
+	[[nodiscard]] auto done() const -> bool
+	{
+		return _handle.promise().done.load(std::memory_order_acquire);
+	}
+
+	auto result() -> T
+	{
+		if constexpr (!std::is_void_v<T>) {
+			return std::move(_handle.promise().result.value());
+		}
+	}
+
+ private:
+	template <bool take_result>
+	class Awaiter
+	{
+	 public:
+		Handle handle;
+
+		[[nodiscard]] auto await_ready() const noexcept -> bool
+		{
+			return false;
+		}
+
+		auto await_suspend(std::coroutine_handle<> awaiting) noexcept
+				-> std::coroutine_handle<>
+		{
+			handle.promise().continuation = awaiting;
+			return handle;
+		}
+
+		auto await_resume()
+		{
+			if constexpr (take_result && !std::is_void_v<T>) {
+				return std::move(handle.promise().result.value());
+			}
+		}
+	};
+
+	Handle _handle;
+};
+
+template <typename T>
+auto detail::Promise<T>::get_return_object() -> Task<T>
+{
+	return Task<T>{Task<T>::Handle::from_promise(*this)};
+}
+
+inline auto detail::Promise<void>::get_return_object() -> Task<void>
+{
+	return Task<void>{Task<void>::Handle::from_promise(*this)};
+}
+
+// Suspends the awaiting coroutine and resumes it as a job.
+inline auto resume_on(JobSystem& jobs)
+{
+	class Awaiter
+	{
+	 public:
+		JobSystem& jobs;
+
+		[[nodiscard]] auto await_ready() const noexcept -> bool
+		{
+			return false;
+		}
+
+		auto await_suspend(std::coroutine_handle<> handle) -> void
+		{
+			jobs.run([handle] { handle.resume(); });
+		}
+
+		auto await_resume() const noexcept -> void {}
+	};
+	return Awaiter{jobs};
+}
+
+// Suspends the awaiting coroutine and resumes it on a background thread.
+inline auto resume_on(BackgroundThreads& threads)
+{
+	class Awaiter
+	{
+	 public:
+		BackgroundThreads& threads;
+
+		[[nodiscard]] auto await_ready() const noexcept -> bool
+		{
+			return false;
+		}
+
+		auto await_suspend(std::coroutine_handle<> handle) -> void
+		{
+			threads.resume(handle);
+		}
+
+		auto await_resume() const noexcept -> void {}
+	};
+	return Awaiter{threads};
+}
+
+namespace detail {
+
+// Resumes `continuation` when the last of `remaining` arrivals comes in.
+class Latch
+{
+ public:
+	explicit Latch(size_t count) : remaining{count} {}
+
+	auto arrive() -> void
+	{
+		if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			continuation.resume();
+		}
+	}
+
+	std::atomic<size_t> remaining;
+	std::coroutine_handle<> continuation;
+};
+
+template <typename T>
+auto arrive_when_done(Task<T>& task, Latch& latch) -> Detached
+{
+	co_await task.completion();
+	latch.arrive();
+}
+
+}  // namespace detail
+
+// Starts every task and resumes once all of them have finished. The results
+// stay in the tasks, to be taken with Task::result.
+template <typename... T>
+auto when_all(Task<T>&... tasks) -> Task<void>
+{
+	class Awaiter
+	{
+	 public:
+		detail::Latch& latch;
+		std::tuple<Task<T>&...> tasks;
+
+		[[nodiscard]] auto await_ready() const noexcept -> bool
+		{
+			return false;
+		}
+
+		auto await_suspend(std::coroutine_handle<> handle) -> bool
+		{
+			latch.continuation = handle;
+			std::apply(
+					[this](auto&... task) { (detail::arrive_when_done(task, latch), ...); },
+					tasks);
+			// The awaiting coroutine holds one arrival itself, so it only suspends
+			// if some task is still running.
+			return latch.remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+		}
+
+		auto await_resume() const noexcept -> void {}
+	};
+	auto latch = detail::Latch{sizeof...(T) + 1};
+	co_await Awaiter{latch, std::tuple<Task<T>&...>{tasks...}};
+}
+
+// Coroutines waiting for a monotonically increasing value, such as a timeline
+// semaphore's, to reach a target. Whoever observes the value passes it to
+// resume_reached, which resumes the satisfied coroutines as jobs.
+class TimelineWaiters
+{
+ public:
+	auto wait(uint64_t value)
+	{
+		class Awaiter
+		{
+		 public:
+			TimelineWaiters& waiters;
+			uint64_t value;
+
+			[[nodiscard]] auto await_ready() const noexcept -> bool
+			{
+				return false;
+			}
+
+			auto await_suspend(std::coroutine_handle<> handle) -> void
+			{
+				auto lock = std::scoped_lock{waiters._mutex};
+				waiters._waiting.push_back(Waiting{value, handle});
+			}
+
+			auto await_resume() const noexcept -> void {}
+		};
+		return Awaiter{*this, value};
+	}
+
+	auto resume_reached(uint64_t current, JobSystem& jobs) -> void
+	{
+		auto lock = std::scoped_lock{_mutex};
+		for (auto i = size_t{}; i < _waiting.size();) {
+			if (_waiting[i].value <= current) {
+				jobs.run([handle = _waiting[i].handle] { handle.resume(); });
+				_waiting[i] = _waiting.back();
+				_waiting.pop_back();
+			} else {
+				++i;
+			}
+		}
+	}
+
+ private:
+	struct Waiting {
+		uint64_t value;
+		std::coroutine_handle<> handle;
+	};
+
+	std::mutex _mutex;
+	std::vector<Waiting> _waiting;
+};
+
+// Runs jobs on the calling thread until a started task has finished, calling
+// `idle` whenever there is nothing to run.
+template <typename T, typename Idle>
+auto wait_until_done(JobSystem& jobs, Task<T> const& task, Idle const& idle)
+		-> void
+{
+	while (!task.done()) {
+		if (!jobs.help()) {
+			idle();
+			std::this_thread::yield();
+		}
+	}
+}
+
+template <typename T, typename Idle>
+auto sync_wait(JobSystem& jobs, Task<T>& task, Idle const& idle) -> void
+{
+	task.start();
+	wait_until_done(jobs, task, idle);
+}